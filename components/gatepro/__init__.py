@@ -0,0 +1,28 @@
+import esphome.codegen as cg
+import esphome.config_validation as cv
+from esphome.const import CONF_ID
+
+MULTI_CONF = True
+
+gatepro_ns = cg.esphome_ns.namespace("gatepro")
+GateProHub = gatepro_ns.class_("GateProHub", cg.Component)
+
+CONF_GATEPRO_HUB_ID = "gatepro_hub_id"
+CONF_LOOP_BUDGET = "loop_budget"
+CONF_POLL_SPACING = "poll_spacing"
+
+# optional hub, running several gates (each on its own uart) from a single loop
+CONFIG_SCHEMA = cv.Schema(
+    {
+        cv.GenerateID(): cv.declare_id(GateProHub),
+        # shared by all the gates of the hub
+        cv.Optional(CONF_LOOP_BUDGET, default="4ms"): cv.positive_time_period_microseconds,
+        # min time between two status polls of any of the gates
+        cv.Optional(CONF_POLL_SPACING, default="50ms"): cv.positive_time_period_milliseconds,
+    }).extend(cv.COMPONENT_SCHEMA)
+
+async def to_code(config):
+    var = cg.new_Pvariable(config[CONF_ID])
+    await cg.register_component(var, config)
+    cg.add(var.set_loop_budget(config[CONF_LOOP_BUDGET]))
+    cg.add(var.set_poll_spacing(config[CONF_POLL_SPACING]))
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "gatepro_prefix_trie.h"
+
 namespace esphome {
 namespace gatepro {
 
@@ -20,36 +22,109 @@ enum GateProCmd : uint8_t {
    GATEPRO_CMD_RESTORE, // untested
    GATEPRO_CMD_PED_OPEN, // untested
    GATEPRO_CMD_READ_FUNCTION, // untested
+   GATEPRO_CMD_COUNT,
+};
+
+// source ID the commands are sent with, configurable as source_id
+#ifndef GATEPRO_SOURCE_ID
+#define GATEPRO_SOURCE_ID "P00287D7"
+#endif
+
+/* Command frames, assembled at compile time into a single flash-resident arena:
+   name [";src=" source ID] "\r\n"
+*/
+struct GateProCmdDef {
+   const char *name;
+   bool with_source;
+};
+inline constexpr GateProCmdDef GateProCmdDefs[GATEPRO_CMD_COUNT] = {
+   /* GATEPRO_CMD_NONE */ {"NAK", false},
+   /* GATEPRO_CMD_OPEN */ {"FULL OPEN", true},
+   /* GATEPRO_CMD_CLOSE */ {"FULL CLOSE", true},
+   /* GATEPRO_CMD_STOP */ {"STOP", true},
+   /* GATEPRO_CMD_READ_STATUS */ {"RS", true},
+   /* GATEPRO_CMD_READ_PARAMS */ {"RP,1:", true},
+   // this is only the start of the cmd! followed by values
+   /* GATEPRO_CMD_WRITE_PARAMS */ {"WP,1:", false},
+   /* GATEPRO_CMD_LEARN */ {"AUTO LEARN", true},
+   /* GATEPRO_CMD_DEVINFO */ {"READ DEVINFO", true},
+   /* GATEPRO_CMD_READ_LEARN_STATUS */ {"READ LEARN STATUS", true},
+   /* GATEPRO_CMD_REMOTE_LEARN */ {"REMOTE LEARN", true},
+   /* GATEPRO_CMD_CLEAR_REMOTE_LEARN */ {"CLEAR REMOTE LEARN", true},
+   /* GATEPRO_CMD_RESTORE */ {"RESTORE", true},
+   /* GATEPRO_CMD_PED_OPEN */ {"PED OPEN", true},
+   /* GATEPRO_CMD_READ_FUNCTION */ {"READ FUNCTION", true},
+};
+
+constexpr char TX_DELIMITER[] = "\r\n";
+constexpr size_t TX_DELIMITER_LENGTH = sizeof(TX_DELIMITER) - 1;
+constexpr char CMD_SOURCE_PREFIX[] = ";src=";
+constexpr char CMD_SOURCE_ID[] = GATEPRO_SOURCE_ID;
+
+constexpr size_t cmd_text_length(const GateProCmdDef &def) {
+   size_t len = 0;
+   while (def.name[len]) {
+      len++;
+   }
+   return len + (def.with_source ? sizeof(CMD_SOURCE_PREFIX) - 1 + sizeof(CMD_SOURCE_ID) - 1 : 0);
+}
+
+constexpr size_t cmd_table_size() {
+   size_t size = 0;
+   for (const auto &def : GateProCmdDefs) {
+      size += cmd_text_length(def) + TX_DELIMITER_LENGTH;
+   }
+   return size;
+}
+
+class GateProCmdTable {
+   public:
+      constexpr GateProCmdTable() : data_{}, offset_{}, len_{} {
+         size_t pos = 0;
+         for (size_t cmd = 0; cmd < GATEPRO_CMD_COUNT; cmd++) {
+            const GateProCmdDef &def = GateProCmdDefs[cmd];
+            this->offset_[cmd] = pos;
+            pos = this->append_(pos, def.name);
+            if (def.with_source) {
+               pos = this->append_(pos, CMD_SOURCE_PREFIX);
+               pos = this->append_(pos, CMD_SOURCE_ID);
+            }
+            pos = this->append_(pos, TX_DELIMITER);
+            this->len_[cmd] = pos - this->offset_[cmd];
+         }
+      }
+
+      // the whole frame, delimiter included
+      constexpr std::string_view frame(GateProCmd cmd) const {
+         return std::string_view(this->data_ + this->offset_[cmd], this->len_[cmd]);
+      }
+      // without the delimiter, e.g. the prefix of a frame to be continued
+      constexpr std::string_view text(GateProCmd cmd) const {
+         return std::string_view(this->data_ + this->offset_[cmd], this->len_[cmd] - (TX_DELIMITER_LENGTH));
+      }
+
+   protected:
+      constexpr size_t append_(size_t pos, const char *str) {
+         for (size_t i = 0; str[i]; i++) {
+            this->data_[pos++] = str[i];
+         }
+         return pos;
+      }
+
+      char data_[cmd_table_size()];
+      uint16_t offset_[GATEPRO_CMD_COUNT];
+      uint8_t len_[GATEPRO_CMD_COUNT];
 };
+inline constexpr GateProCmdTable GateProCmds{};
+static_assert(GateProCmds.text(GATEPRO_CMD_STOP) == "STOP;src=" GATEPRO_SOURCE_ID);
+static_assert(GateProCmds.text(GATEPRO_CMD_WRITE_PARAMS) == "WP,1:");
 
-const std::map<std::string, GateProCmd> GateProUIBtnMapping = {
-   {"GATEPRO_CMD_OPEN", GATEPRO_CMD_OPEN},
-   {"GATEPRO_CMD_CLOSE", GATEPRO_CMD_CLOSE},
-   {"GATEPRO_CMD_READ_STATUS", GATEPRO_CMD_READ_STATUS},
-   {"GATEPRO_CMD_READ_PARAMS", GATEPRO_CMD_READ_PARAMS},
-   {"GATEPRO_CMD_REMOTE_LEARN", GATEPRO_CMD_REMOTE_LEARN},
-   {"GATEPRO_CMD_CLEAR_REMOTE_LEARN", GATEPRO_CMD_CLEAR_REMOTE_LEARN},
-   {"GATEPRO_CMD_RESTORE", GATEPRO_CMD_RESTORE},
-   {"GATEPRO_CMD_PED_OPEN", GATEPRO_CMD_PED_OPEN},
-   {"GATEPRO_CMD_READ_FUNCTION", GATEPRO_CMD_READ_FUNCTION},
-};
-
-const std::map<GateProCmd, const char*> GateProCmdMapping = {
-   {GATEPRO_CMD_NONE, "NAK"},
-   {GATEPRO_CMD_OPEN, "FULL OPEN;src=P00287D7"},
-   {GATEPRO_CMD_CLOSE, "FULL CLOSE;src=P00287D7"},
-   {GATEPRO_CMD_STOP, "STOP;src=P00287D7"},
-   {GATEPRO_CMD_READ_STATUS, "RS;src=P00287D7"},
-   {GATEPRO_CMD_READ_PARAMS, "RP,1:;src=P00287D7"},
-   {GATEPRO_CMD_WRITE_PARAMS, "WP,1:"}, // this is only the start of the cmd! followed by values
-   {GATEPRO_CMD_LEARN, "AUTO LEARN;src=P00287D7"},
-   {GATEPRO_CMD_DEVINFO, "READ DEVINFO;src=P00287D7"},
-   {GATEPRO_CMD_READ_LEARN_STATUS, "READ LEARN STATUS;src=P00287D7"},
-   {GATEPRO_CMD_REMOTE_LEARN, "REMOTE LEARN;src=P00287D7"},
-   {GATEPRO_CMD_CLEAR_REMOTE_LEARN, "CLEAR REMOTE LEARN;src=P00287D7"},
-   {GATEPRO_CMD_RESTORE, "RESTORE;src=P00287D7"},
-   {GATEPRO_CMD_PED_OPEN, "PED OPEN;src=P00287D7"},
-   {GATEPRO_CMD_READ_FUNCTION, "READ FUNCTION;src=P00287D7"},
+// TX priority classes, a queued command of a higher class always goes out first
+enum GateProTxPriority : uint8_t {
+   GATEPRO_TX_PRIO_MOTION,
+   GATEPRO_TX_PRIO_PARAM,
+   GATEPRO_TX_PRIO_POLL,
+   GATEPRO_TX_PRIO_COUNT,
 };
 
 enum GateProMsgType : uint8_t {
@@ -75,92 +150,310 @@ enum GateProMsgType : uint8_t {
    MOTOR_EVENT_PED_OPENED   
 };
 
-struct GateProMsgConstant {
-   int pos;
-   int len;
-   std::string match;
+struct GateProCmdSpec {
+   GateProTxPriority prio;
+   // ACK answering the command, GATEPRO_MSG_UNKNOWN: not tracked
+   GateProMsgType ack;
+   uint16_t timeout_ms;
+   uint8_t retries;
+};
+
+// indexed by GateProCmd
+inline constexpr GateProCmdSpec GateProCmdSpecs[GATEPRO_CMD_COUNT] = {
+   /* GATEPRO_CMD_NONE */ {GATEPRO_TX_PRIO_POLL, GATEPRO_MSG_UNKNOWN, 0, 0},
+   /* GATEPRO_CMD_OPEN */ {GATEPRO_TX_PRIO_MOTION, GATEPRO_MSG_ACK_FULL_OPEN, 1000, 1},
+   /* GATEPRO_CMD_CLOSE */ {GATEPRO_TX_PRIO_MOTION, GATEPRO_MSG_ACK_FULL_CLOSE, 1000, 1},
+   /* GATEPRO_CMD_STOP */ {GATEPRO_TX_PRIO_MOTION, GATEPRO_MSG_ACK_STOP, 500, 2},
+   // RS isn't retried, the poller simply polls again
+   /* GATEPRO_CMD_READ_STATUS */ {GATEPRO_TX_PRIO_POLL, GATEPRO_MSG_ACK_RS, 500, 0},
+   /* GATEPRO_CMD_READ_PARAMS */ {GATEPRO_TX_PRIO_PARAM, GATEPRO_MSG_ACK_RP, 1000, 2},
+   /* GATEPRO_CMD_WRITE_PARAMS */ {GATEPRO_TX_PRIO_PARAM, GATEPRO_MSG_ACK_WP, 1000, 2},
+   /* GATEPRO_CMD_LEARN */ {GATEPRO_TX_PRIO_PARAM, GATEPRO_MSG_UNKNOWN, 0, 0},
+   /* GATEPRO_CMD_DEVINFO */ {GATEPRO_TX_PRIO_POLL, GATEPRO_MSG_ACK_READ_DEVINFO, 1000, 2},
+   /* GATEPRO_CMD_READ_LEARN_STATUS */ {GATEPRO_TX_PRIO_POLL, GATEPRO_MSG_ACK_LEARN_STATUS, 1000, 2},
+   /* GATEPRO_CMD_REMOTE_LEARN */ {GATEPRO_TX_PRIO_PARAM, GATEPRO_MSG_UNKNOWN, 0, 0},
+   /* GATEPRO_CMD_CLEAR_REMOTE_LEARN */ {GATEPRO_TX_PRIO_PARAM, GATEPRO_MSG_UNKNOWN, 0, 0},
+   /* GATEPRO_CMD_RESTORE */ {GATEPRO_TX_PRIO_PARAM, GATEPRO_MSG_UNKNOWN, 0, 0},
+   /* GATEPRO_CMD_PED_OPEN */ {GATEPRO_TX_PRIO_MOTION, GATEPRO_MSG_ACK_PED_OPEN, 1000, 1},
+   /* GATEPRO_CMD_READ_FUNCTION */ {GATEPRO_TX_PRIO_POLL, GATEPRO_MSG_UNKNOWN, 0, 0},
 };
 
-const std::map<GateProMsgType, const GateProMsgConstant> GateProMsgTypeMapping = {
+/* Param entity descriptors, emitted by codegen as static constexpr tables,
+   the component only keeps pointers to them
+*/
+struct GateProSwitchDesc {
+   uint8_t idx;
+   int16_t on_value;
+   int16_t off_value;
+};
+struct GateProSelectDesc {
+   uint8_t idx;
+   uint8_t count;
+   const char *const *options;
+   const int16_t *values;
+
+   // option index of a raw param value, count if there's none
+   size_t index_of(int value) const {
+      size_t i = 0;
+      while (i < this->count && this->values[i] != value) {
+         i++;
+      }
+      return i;
+   }
+};
+
+// Diagnostic sensors
+enum GateProDiag : uint8_t {
+   GATEPRO_DIAG_RX_HEAP_DELTA, // net free heap lost during RX passes (negative: gained), in bytes
+   GATEPRO_DIAG_RX_BACKLOG, // high-water of bytes left in the RX ring after a loop
+   GATEPRO_DIAG_SUPPRESSED_PUBLISHES, // entity publishes skipped as the param didn't change
+   GATEPRO_DIAG_TX_LATENCY, // enqueued -> written latency of the last motion command, in us
+   GATEPRO_DIAG_RTT_MIN, // command -> ACK round trip times, in ms
+   GATEPRO_DIAG_RTT_AVG,
+   GATEPRO_DIAG_RTT_MAX,
+   GATEPRO_DIAG_RETRIES, // commands resent after their ACK timed out
+   GATEPRO_DIAG_POLLS_PER_OPERATION, // RS polls sent during the last operation
+   GATEPRO_DIAG_STOP_LATENCY, // STOP queued -> Stopped event, in ms (smoothed)
+   GATEPRO_DIAG_STOP_OVERSHOOT, // last stop at a partial target, % past the target
+   GATEPRO_DIAG_STOP_OVERSHOOT_AVG, // mean absolute overshoot, in %
+   GATEPRO_DIAG_FRAMES_SEEN, // complete RX frames
+   GATEPRO_DIAG_UNKNOWN_FRAMES, // RX frames of no known type
+   GATEPRO_DIAG_TIME_SINCE_RX, // since the last RX frame, in s
+   GATEPRO_DIAG_RX_HIGH_WATER, // most bytes ever held by the RX ring
+   GATEPRO_DIAG_RX_DROPPED, // bytes dropped on RX ring overflow
+   GATEPRO_DIAG_TX_HIGH_WATER, // most commands ever queued for TX, all classes together
+   GATEPRO_DIAG_TX_DROPPED, // commands dropped (or refused) on full TX queues
+   GATEPRO_DIAG_PARAM_FAILURES, // param edits given up, for a missing ACK or a full pool
+   GATEPRO_DIAG_LOOP_IDLE_RATIO, // share of time the loop was asleep, in % (since the last update)
+   GATEPRO_DIAG_COUNT,
+};
+
+/* Message type patterns, every frame is classified by the first matching prefix
+   in a single pass, see GateProPrefixTrie
+*/
+inline constexpr GateProPattern<GateProMsgType> GateProMsgTypePatterns[] = {
    // ACK RS:00,80,C4,C6,3E,16,FF,FF,FF\r\n
-   {GATEPRO_MSG_ACK_RS, {0, 6, "ACK RS"}},
+   {GATEPRO_MSG_ACK_RS, "ACK RS"},
    // ACK RP,1:1,0,0,1,2,2,0,0,0,3,0,0,3,0,0,0,0\r\n"
-   {GATEPRO_MSG_ACK_RP, {0, 6, "ACK RP"}},
+   {GATEPRO_MSG_ACK_RP, "ACK RP"},
    // ACK WP,1\r\n
-   {GATEPRO_MSG_ACK_RP, {0, 6, "ACK WP"}},
+   {GATEPRO_MSG_ACK_WP, "ACK WP"},
    // $V1PKF0,17,Closed;src=0001\r\n
-   {GATEPRO_MSG_MOTOR_EVENT, {0, 7, "$V1PKF0"}},
+   {GATEPRO_MSG_MOTOR_EVENT, "$V1PKF0"},
    // ACK READ DEVINFO:P500BU,PS21053C,V01\r\n
-   {GATEPRO_MSG_ACK_READ_DEVINFO, {0, 16, "ACK READ DEVINFO"}},
+   {GATEPRO_MSG_ACK_READ_DEVINFO, "ACK READ DEVINFO"},
    // ACK LEARN STATUS:SYSTEM LEARN COMPLETE,0\r\n
-   {GATEPRO_MSG_ACK_LEARN_STATUS, {0, 16, "ACK LEARN STATUS"}},
+   {GATEPRO_MSG_ACK_LEARN_STATUS, "ACK LEARN STATUS"},
    // ACK FULL CLOSE\r\n
-   {GATEPRO_MSG_ACK_FULL_CLOSE, {0, 14, "ACK FULL CLOSE"}},
+   {GATEPRO_MSG_ACK_FULL_CLOSE, "ACK FULL CLOSE"},
    // ACK FULL OPEN\r\n
-   {GATEPRO_MSG_ACK_FULL_OPEN, {0, 13, "ACK FULL OPEN"}},
+   {GATEPRO_MSG_ACK_FULL_OPEN, "ACK FULL OPEN"},
    // ACK STOP\r\n
-   {GATEPRO_MSG_ACK_STOP, {0, 8, "ACK STOP"}},
+   {GATEPRO_MSG_ACK_STOP, "ACK STOP"},
    // ACK PED OPEN\r\n
-   {GATEPRO_MSG_ACK_PED_OPEN, {0, 12,"ACK PED OPEN"}},
+   {GATEPRO_MSG_ACK_PED_OPEN, "ACK PED OPEN"},
    // $V1PKF1
-   {GATPERO_MSG_FINISHED, {0, 7, "$V1PKF1"}}
-};
-
-const std::map<GateProMsgType, const GateProMsgConstant> MotorEvents = {
-   // $V1PKF0,??,Opening;src=0001\r\n
-   {MOTOR_EVENT_OPENING, {11, 7, "Opening"}},
-   // $V1PKF0,??,Opened;src=0001\r\n
-   {MOTOR_EVENT_OPENED, {11, 6, "Opened"}},
-   // $V1PKF0,??,Closing;src=0001\r\n
-   {MOTOR_EVENT_CLOSING, {11, 7, "Closing"}},
-   // $V1PKF0,??,AutoClosing;src=0001\r\n
-   {MOTOR_EVENT_AUTOCLOSING, {11, 11, "AutoClosing"}},
-   // $V1PKF0,??,Closed;src=0001\r\n
-   {MOTOR_EVENT_CLOSED, {11, 6, "Closed"}},
-   // $V1PKF0,??,Stopped;src=0001\r\n
-   {MOTOR_EVENT_STOPPED, {11, 7, "Stopped"}},
-   // $V1PKF0,??,PedOpening;src=P00287D7\r\n
-   {MOTOR_EVENT_PED_OPENING, {11, 10, "PedOpening"}},
-   // $V1PKF0,??,PedOpened;src=P00287D7\r\n
-   {MOTOR_EVENT_PED_OPENED, {11, 9, "PedOpened"}},
-};
-
-// necessary for comfortable processing & to avoid confusion
-const std::map<int, const std::string> ConversionMap {
-   {7, "\\a"},
-   {8, "\\b"},
-   {9, "\\t"},
-   {10, "\\n"},
-   {11, "\\v"},
-   {12, "\\f"},
-   {13, "\\r"},
-   {27, "\\e"},
-   {34, "\\\""},
-   {39, "\\'"},
-   {92, "\\\\"},
+   {GATPERO_MSG_FINISHED, "$V1PKF1"},
+};
+
+/* Motor event patterns, matched against the 3rd token of a motor event
+   example: $V1PKF0,17,Closed;src=0001\r\n
+                       ^- event
+*/
+inline constexpr GateProPattern<GateProMsgType> MotorEventPatterns[] = {
+   {MOTOR_EVENT_OPENING, "Opening"},
+   {MOTOR_EVENT_OPENED, "Opened"},
+   {MOTOR_EVENT_CLOSING, "Closing"},
+   {MOTOR_EVENT_AUTOCLOSING, "AutoClosing"},
+   {MOTOR_EVENT_CLOSED, "Closed"},
+   {MOTOR_EVENT_STOPPED, "Stopped"},
+   {MOTOR_EVENT_PED_OPENING, "PedOpening"},
+   {MOTOR_EVENT_PED_OPENED, "PedOpened"},
 };
 
+inline constexpr GateProPrefixTrie<GateProMsgType, trie_nodes(GateProMsgTypePatterns)> GateProMsgTypeTrie(
+   GateProMsgTypePatterns, GATEPRO_MSG_UNKNOWN);
+inline constexpr GateProPrefixTrie<GateProMsgType, trie_nodes(MotorEventPatterns)> MotorEventTrie(
+   MotorEventPatterns, GATEPRO_MSG_UNKNOWN);
+// motor event name follows this many separators
+const uint8_t MOTOR_EVENT_TOKEN = 2;
+const char MOTOR_EVENT_SEPARATOR = ',';
+
+// escape sequences of non-printable bytes, only used when logging frames
+constexpr const char *escape_sequence(uint8_t byte) {
+   switch (byte) {
+      case 7: return "\\a";
+      case 8: return "\\b";
+      case 9: return "\\t";
+      case 10: return "\\n";
+      case 11: return "\\v";
+      case 12: return "\\f";
+      case 13: return "\\r";
+      case 27: return "\\e";
+      case 34: return "\\\"";
+      case 39: return "\\'";
+      case 92: return "\\\\";
+      default: return nullptr;
+   }
+}
+
 /* Misc constants
 */
-const std::string DELIMITER = "\\r\\n";
-const uint8_t DELIMITER_LENGTH = DELIMITER.length();
-const std::string TX_DELIMITER = "\r\n";
+// owned TX buffers for dynamically built frames (WP), and their capacity
+const size_t TX_POOL_SIZE = 2;
+const size_t TX_FRAME_SIZE = 128;
+// default minimum gap between two TX frames
+const uint32_t TX_MIN_GAP_MS = 100;
+// motion commands only keep this gap, about the time a frame takes on the wire at 9600 baud
+const uint32_t TX_MOTION_MIN_GAP_MS = 20;
+// max commands awaiting their ACK at the same time
+const size_t IN_FLIGHT_MAX = 4;
+// RX ring capacity in bytes, comfortably fits a burst of the longest frames (ACK RP ~42 bytes)
+#ifndef GATEPRO_RX_RING_SIZE
+#define GATEPRO_RX_RING_SIZE 256
+#endif
+const size_t RX_RING_SIZE = GATEPRO_RX_RING_SIZE;
+// TX queue capacity per priority class, in commands
+#ifndef GATEPRO_TX_QUEUE_DEPTH
+#define GATEPRO_TX_QUEUE_DEPTH 8
+#endif
+const size_t TX_QUEUE_DEPTH = GATEPRO_TX_QUEUE_DEPTH;
+// escaped frames longer than this are truncated in the logs
+const size_t LOG_FRAME_SIZE = 160;
+// default max time spent draining RX frames per loop
+const uint32_t LOOP_BUDGET_US = 2000;
+// hub: max gates, default loop budget shared by them and min time between two status polls of any of them
+const size_t HUB_GATES_MAX = 4;
+const uint32_t HUB_LOOP_BUDGET_US = 4000;
+const uint32_t HUB_POLL_SPACING_MS = 50;
 
 // maximum acceptable difference of target pos / current pos in %
 const float ACCEPTABLE_DIFF = 0.05f;
 // ticks to update after an operation
 const int AFTER_TICK_MAX = 10;
-// status percentage location
-      // example: ACK RS:00,80,C4,C6,3E,16,FF,FF,FF\r\n
-      //                          ^- percentage in hex
-const GateProMsgConstant STATUS_PERCENTAGE = {16, 2, ""};
-// status: if currently moving, 3rd token is C4
-const GateProMsgConstant STATUS_OP_MOVING = {13, 2, "C4"};
+// devinfo / learn status text starts here, after "ACK READ DEVINFO:" / "ACK LEARN STATUS:"
+const size_t INFO_START = 17;
+// status frame: hex bytes following the start char
+// example: ACK RS:00,80,C4,C6,3E,16,FF,FF,FF\r\n
+//                       ^- 3rd byte is C4 while moving
+//                          ^- 4th byte is the percentage
+const char STATUS_START = ':';
+const char STATUS_SEPARATOR = ',';
+const size_t STATUS_BYTES = 9;
+const size_t STATUS_IDX_STATE = 2;
+const uint8_t STATUS_STATE_MOVING = 0xC4;
+const size_t STATUS_IDX_PERCENTAGE = 3;
 // percentage is offset by +128 when opening, so e.g. 50 => 50+128=178
 const int PERCENTAGE_OFFSET_WHILE_OPENING = 128;
+
+// decoded status frame, only the known fields have accessors so far
+struct GateProStatus {
+   uint8_t bytes[STATUS_BYTES];
+   uint8_t count;
+
+   bool moving() const { return this->bytes[STATUS_IDX_STATE] == STATUS_STATE_MOVING; }
+   uint8_t raw_percentage() const { return this->bytes[STATUS_IDX_PERCENTAGE]; }
+   bool opening() const { return this->raw_percentage() > 100; }
+   // 0..100, or 128..228 while opening; anything else can't be a percentage
+   bool valid() const {
+      return this->raw_percentage() <= 100 || (this->raw_percentage() >= PERCENTAGE_OFFSET_WHILE_OPENING &&
+                                               this->raw_percentage() <= PERCENTAGE_OFFSET_WHILE_OPENING + 100);
+   }
+   uint8_t percentage() const {
+      return this->opening() ? this->raw_percentage() - PERCENTAGE_OFFSET_WHILE_OPENING : this->raw_percentage();
+   }
+} __attribute__((packed));
 // example: ACK RP,1:1,0,0,1,2,2,0,0,0,3,0,0,3,0,0,0,0\r\n"
-//                   ^-9  
-const GateProMsgConstant PARAMS = {9, 33, ""};
-const std::string PARAMS_SEPARATOR = ",";
+//                  ^- params follow
+const char PARAMS_START = ':';
+const char PARAMS_SEPARATOR = ',';
+// param list capacity, controllers known so far report 17
+const size_t PARAMS_MAX = 32;
+static_assert(PARAMS_MAX <= 32, "changed params are tracked in a 32 bit mask");
+// param changes within this window are written together
+const uint32_t PARAM_WRITE_WINDOW_MS = 300;
+// cached params are written back without a pre-read while younger than this
+const uint32_t PARAMS_MAX_AGE_MS = 10000;
+// param edits tracked at the same time, and how long a read / write may take before the edit fails
+// (longer than the RP / WP ACK timeouts with all their retries)
+const size_t PARAM_TXN_MAX = 16;
+const uint32_t PARAM_TXN_TIMEOUT_MS = 5000;
+
+// a single param edit on its way to the controller
+enum GateProParamTxnState : uint8_t {
+   GATEPRO_PARAM_TXN_FREE,
+   GATEPRO_PARAM_TXN_PENDING, // collected, until the write window closes
+   GATEPRO_PARAM_TXN_READING, // waiting for the RP to modify
+   GATEPRO_PARAM_TXN_WRITING, // WP sent, waiting for its ACK
+};
+struct GateProParamTxn {
+   GateProParamTxnState state;
+   uint8_t idx;
+   int16_t value;
+   uint32_t deadline;
+};
+
+// params the poller's policy is based on
+const size_t PARAM_IDX_OPERATIONAL_SPEED = 3;
+const size_t PARAM_IDX_DECEL_DIST = 4;
+/* operational_speed / decel_dist select values mapped to fractions. These are rough
+   guesses, nothing the controller reports or documents: the speeds are only used until
+   a real speed is learned (see current_speed()), the decel distances can't be learned.
+*/
+const float OPERATIONAL_SPEEDS[] = {0.50f, 0.70f, 0.85f, 1.00f};
+const size_t SPEED_SETTINGS = sizeof(OPERATIONAL_SPEEDS) / sizeof(float);
+const float DECEL_DISTS[] = {0.75f, 0.80f, 0.85f, 0.90f, 0.95f};
+const size_t DECEL_SETTINGS = sizeof(DECEL_DISTS) / sizeof(float);
+// used until the params are known
+const float DEFAULT_OPERATIONAL_SPEED = 1.00f;
+const float DEFAULT_DECEL_DIST = 0.85f;
+// fast polling starts this long before reaching the target / decel zone at the learned speed,
+// or, without one, this far (in travel fraction, at full speed)
+const float POLL_NEAR_TIME_S = 2.5f;
+const float POLL_NEAR_WINDOW = 0.15f;
+// default poll intervals
+const uint32_t POLL_INTERVAL_FAST_MS = 250;
+const uint32_t POLL_INTERVAL_CRUISE_MS = 1000;
+// the controller isn't polled at rest unless asked to (the link watchdog still probes it)
+const uint32_t POLL_INTERVAL_IDLE_MS = 0;
+// link watchdog: the controller is probed with RS once it's quiet for half the timeout,
+// and considered lost after the whole timeout
+const uint32_t LINK_TIMEOUT_MS = 60000;
+// while idle, the loop sleeps and UART RX / due work is checked this often instead
+const uint32_t IDLE_WAKE_CHECK_MS = 20;
+// default rate of publishing interpolated positions
+const uint32_t INTERPOLATION_INTERVAL_MS = 250;
+// learned speeds follow new samples with this weight
+const float SPEED_EMA_ALPHA = 0.3f;
+// samples closer than this in time are too noisy to learn the speed from
+const uint32_t SPEED_SAMPLE_MIN_MS = 150;
+// STOP queued -> Stopped event, assumed until measured
+const float STOP_LATENCY_MS = 600;
+const float STOP_LATENCY_EMA_ALPHA = 0.3f;
+// a Stopped event this long after the STOP can't be its answer (sent into a lost link, or the gate hit an end stop first)
+const uint32_t STOP_LATENCY_MAX_MS = 3000;
+
+// state kept in preferences across reboots, bump the version when changing the layout
+const uint32_t PERSISTED_STATE_VERSION = 0x6A7E0001;
+const size_t PERSISTED_TEXT_SIZE = 48;
+struct GateProPersistedState {
+   int16_t params[PARAMS_MAX];
+   uint8_t params_count;
+   char devinfo[PERSISTED_TEXT_SIZE];
+   char learn_status[PERSISTED_TEXT_SIZE];
+} __attribute__((packed));
+
+// learned full travel times, kept in preferences apart from the param cache
+const uint32_t TRAVEL_PROFILE_VERSION = 0x6A7E1001;
+struct GateProTravelProfile {
+   float open_s;
+   float close_s;
+};
+// travel times follow new measurements with this weight
+const float TRAVEL_EMA_ALPHA = 0.25f;
+// shorter travels aren't representative of the full travel time
+const float TRAVEL_MIN_FRACTION = 0.5f;
+// ETA sensors are republished when they change at least this much, in s
+const float ETA_RESOLUTION_S = 0.1f;
 
 }}
\ No newline at end of file
@@ -1,12 +1,22 @@
+import re
 import esphome.codegen as cg
 import esphome.config_validation as cv
-from esphome.components import uart, sensor, cover, button, number, text_sensor, switch, select
-from esphome.const import CONF_ID, ICON_EMPTY, UNIT_EMPTY, CONF_NAME, CONF_ENTITY_CATEGORY
+import esphome.final_validate as fv
+from esphome.helpers import cpp_string_escape
+from esphome.components import uart, sensor, binary_sensor, cover, button, number, text_sensor, switch, select
+from esphome.const import (
+    CONF_ID, CONF_PLATFORM, ICON_EMPTY, UNIT_EMPTY, CONF_NAME, CONF_ENTITY_CATEGORY,
+    ENTITY_CATEGORY_DIAGNOSTIC, STATE_CLASS_MEASUREMENT, DEVICE_CLASS_DURATION,
+)
 
-AUTO_LOAD = ["switch", "select", "button"]
+AUTO_LOAD = ["switch", "select", "button", "sensor", "binary_sensor"]
 DEPENDENCIES = ["uart", "cover"]
 
-gatepro_ns = cg.esphome_ns.namespace("gatepro")
+from . import gatepro_ns, GateProHub, CONF_GATEPRO_HUB_ID
+
+GateProSwitchDesc = gatepro_ns.struct("GateProSwitchDesc")
+GateProSelectDesc = gatepro_ns.struct("GateProSelectDesc")
+
 GatePro = gatepro_ns.class_(
     "GatePro", cover.Cover, cg.PollingComponent, uart.UARTDevice
 )
@@ -44,6 +54,26 @@ TEXT_SENSOR_SCHEMA = text_sensor.text_sensor_schema(GateProTextSensor).extend(
 )
 
 CONF_OPERATIONAL_SPEED = "operational_speed"
+CONF_LOOP_BUDGET = "loop_budget"
+CONF_PARAM_WRITE_WINDOW = "param_write_window"
+CONF_PARAMS_MAX_AGE = "params_max_age"
+CONF_TX_MIN_GAP = "tx_min_gap"
+CONF_TX_WAIT_ACK = "tx_wait_ack"
+CONF_POLL_INTERVAL_FAST = "poll_interval_fast"
+CONF_POLL_INTERVAL_CRUISE = "poll_interval_cruise"
+CONF_POLL_INTERVAL_IDLE = "poll_interval_idle"
+CONF_INTERPOLATION_INTERVAL = "interpolation_interval"
+CONF_LINK_TIMEOUT = "link_timeout"
+CONF_RX_BUFFER_SIZE = "rx_buffer_size"
+CONF_TX_QUEUE_DEPTH = "tx_queue_depth"
+CONF_SOURCE_ID = "source_id"
+CONF_IDLE_SLEEP = "idle_sleep"
+
+def validate_source_id(value):
+    value = cv.string_strict(value)
+    if not re.fullmatch(r"[0-9A-Za-z]{1,16}", value):
+        raise cv.Invalid("source_id must be 1-16 letters / digits")
+    return value
 
 cover.COVER_OPERATIONS.update({
     "READ_STATUS": cover.CoverOperation.COVER_OPERATION_READ_STATUS,
@@ -53,12 +83,64 @@ validate_cover_operation = cv.enum(cover.COVER_OPERATIONS, upper=True)
 # text sensors
 CONF_DEVINFO = "devinfo"
 CONF_LEARN_STATUS = "learn_status"
+CONF_STATUS_RAW = "status_raw"
+
+# binary sensors, decoded from the RS status frame
+CONF_MOVING = "moving"
+CONF_OPENING = "opening"
+
+# sensors
+CONF_TIME_TO_OPEN = "time_to_open"
+CONF_TIME_TO_CLOSE = "time_to_close"
+CONF_STATUS_POSITION = "status_position"
+ETA_SENSOR_SCHEMA = sensor.sensor_schema(
+    unit_of_measurement="s",
+    accuracy_decimals=1,
+    device_class=DEVICE_CLASS_DURATION,
+    state_class=STATE_CLASS_MEASUREMENT,
+)
 
 CONFIG_SCHEMA = cover.cover_schema(GatePro).extend(
     {
         # TEXT SENSORS
         cv.Optional(CONF_DEVINFO): TEXT_SENSOR_SCHEMA,
         cv.Optional(CONF_LEARN_STATUS): TEXT_SENSOR_SCHEMA,
+        cv.Optional(CONF_STATUS_RAW): TEXT_SENSOR_SCHEMA,
+        # BINARY SENSORS
+        cv.Optional(CONF_MOVING): binary_sensor.binary_sensor_schema(),
+        cv.Optional(CONF_OPENING): binary_sensor.binary_sensor_schema(),
+        # SENSORS
+        cv.Optional(CONF_TIME_TO_OPEN): ETA_SENSOR_SCHEMA,
+        cv.Optional(CONF_TIME_TO_CLOSE): ETA_SENSOR_SCHEMA,
+        cv.Optional(CONF_STATUS_POSITION): sensor.sensor_schema(
+            unit_of_measurement="%",
+            accuracy_decimals=0,
+            state_class=STATE_CLASS_MEASUREMENT,
+        ),
+        cv.Optional(CONF_LOOP_BUDGET, default="2ms"): cv.positive_time_period_microseconds,
+        cv.Optional(CONF_PARAM_WRITE_WINDOW, default="300ms"): cv.positive_time_period_milliseconds,
+        cv.Optional(CONF_PARAMS_MAX_AGE, default="10s"): cv.positive_time_period_milliseconds,
+        # motion commands (e.g. STOP) are exempt, they go out within ~20ms of the previous frame
+        cv.Optional(CONF_TX_MIN_GAP, default="100ms"): cv.positive_time_period_milliseconds,
+        cv.Optional(CONF_TX_WAIT_ACK, default=False): cv.boolean,
+        cv.Optional(CONF_POLL_INTERVAL_FAST, default="250ms"): cv.positive_time_period_milliseconds,
+        cv.Optional(CONF_POLL_INTERVAL_CRUISE, default="1s"): cv.positive_time_period_milliseconds,
+        # 0s disables polling while idle
+        cv.Optional(CONF_POLL_INTERVAL_IDLE, default="0s"): cv.positive_time_period_milliseconds,
+        # 0s disables position interpolation
+        cv.Optional(CONF_INTERPOLATION_INTERVAL, default="250ms"): cv.positive_time_period_milliseconds,
+        # 0s disables the link watchdog
+        cv.Optional(CONF_LINK_TIMEOUT, default="60s"): cv.positive_time_period_milliseconds,
+        # fixed at build time (no heap is used for RX/TX buffering), the same for every gatepro cover
+        cv.Optional(CONF_RX_BUFFER_SIZE, default=256): cv.int_range(min=64, max=4096),
+        cv.Optional(CONF_TX_QUEUE_DEPTH, default=8): cv.int_range(min=2, max=64),
+        # sent along with every command, built into the command table at compile time,
+        # so it's the same for every gatepro cover of the node
+        cv.Optional(CONF_SOURCE_ID, default="P00287D7"): validate_source_id,
+        # disable the loop while the gate is at rest with nothing to send or receive
+        cv.Optional(CONF_IDLE_SLEEP, default=True): cv.boolean,
+        # run from a shared hub, instead of its own loop
+        cv.Optional(CONF_GATEPRO_HUB_ID): cv.use_id(GateProHub),
     }).extend(cv.COMPONENT_SCHEMA).extend(cv.polling_component_schema("60s")).extend(uart.UART_DEVICE_SCHEMA)
 
 # BUTTON controllers mapping
@@ -165,11 +247,144 @@ for k, v in SELECTS.items():
       cv.Optional(k): SELECT_SCHEMA
    })
 
+# DIAGNOSTIC SENSORS mapping
+# name - {diagnostic value, unit}
+DIAG_SENSORS = {
+   "rx_heap_delta": {
+      "diag": "GATEPRO_DIAG_RX_HEAP_DELTA",
+      "unit": "B"
+   },
+   "rx_backlog": {
+      "diag": "GATEPRO_DIAG_RX_BACKLOG",
+      "unit": "B"
+   },
+   "suppressed_publishes": {
+      "diag": "GATEPRO_DIAG_SUPPRESSED_PUBLISHES",
+      "unit": UNIT_EMPTY
+   },
+   "tx_latency": {
+      "diag": "GATEPRO_DIAG_TX_LATENCY",
+      "unit": "µs"
+   },
+   "rtt_min": {
+      "diag": "GATEPRO_DIAG_RTT_MIN",
+      "unit": "ms"
+   },
+   "rtt_avg": {
+      "diag": "GATEPRO_DIAG_RTT_AVG",
+      "unit": "ms"
+   },
+   "rtt_max": {
+      "diag": "GATEPRO_DIAG_RTT_MAX",
+      "unit": "ms"
+   },
+   "retries": {
+      "diag": "GATEPRO_DIAG_RETRIES",
+      "unit": UNIT_EMPTY
+   },
+   "polls_per_operation": {
+      "diag": "GATEPRO_DIAG_POLLS_PER_OPERATION",
+      "unit": UNIT_EMPTY
+   },
+   "stop_latency": {
+      "diag": "GATEPRO_DIAG_STOP_LATENCY",
+      "unit": "ms"
+   },
+   "stop_overshoot": {
+      "diag": "GATEPRO_DIAG_STOP_OVERSHOOT",
+      "unit": "%"
+   },
+   "stop_overshoot_avg": {
+      "diag": "GATEPRO_DIAG_STOP_OVERSHOOT_AVG",
+      "unit": "%"
+   },
+   "frames_seen": {
+      "diag": "GATEPRO_DIAG_FRAMES_SEEN",
+      "unit": UNIT_EMPTY
+   },
+   "unknown_frames": {
+      "diag": "GATEPRO_DIAG_UNKNOWN_FRAMES",
+      "unit": UNIT_EMPTY
+   },
+   "time_since_rx": {
+      "diag": "GATEPRO_DIAG_TIME_SINCE_RX",
+      "unit": "s"
+   },
+   "rx_high_water": {
+      "diag": "GATEPRO_DIAG_RX_HIGH_WATER",
+      "unit": "B"
+   },
+   "rx_dropped": {
+      "diag": "GATEPRO_DIAG_RX_DROPPED",
+      "unit": "B"
+   },
+   "tx_high_water": {
+      "diag": "GATEPRO_DIAG_TX_HIGH_WATER",
+      "unit": UNIT_EMPTY
+   },
+   "tx_dropped": {
+      "diag": "GATEPRO_DIAG_TX_DROPPED",
+      "unit": UNIT_EMPTY
+   },
+   "param_failures": {
+      "diag": "GATEPRO_DIAG_PARAM_FAILURES",
+      "unit": UNIT_EMPTY
+   },
+   "loop_idle_ratio": {
+      "diag": "GATEPRO_DIAG_LOOP_IDLE_RATIO",
+      "unit": "%"
+   },
+}
+for k, v in DIAG_SENSORS.items():
+   CONFIG_SCHEMA = CONFIG_SCHEMA.extend({
+      cv.Optional(k): sensor.sensor_schema(
+         unit_of_measurement=v["unit"],
+         accuracy_decimals=0,
+         state_class=STATE_CLASS_MEASUREMENT,
+         entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+      )
+   })
+
+# options compiled into the build as defines, shared by all the gatepro covers
+BUILD_WIDE_OPTIONS = [CONF_RX_BUFFER_SIZE, CONF_TX_QUEUE_DEPTH, CONF_SOURCE_ID]
+
+def final_validate(config):
+    covers = [
+        c for c in fv.full_config.get().get("cover", []) if c.get(CONF_PLATFORM) == "gatepro"
+    ]
+    for key in BUILD_WIDE_OPTIONS:
+        values = {c[key] for c in covers}
+        if len(values) > 1:
+            raise cv.Invalid(
+                f"{key} is built into the firmware, all gatepro covers must use the same value "
+                f"(got {', '.join(str(v) for v in sorted(values))})"
+            )
+    return config
+
+FINAL_VALIDATE_SCHEMA = final_validate
+
 async def to_code(config):
     var = cg.new_Pvariable(config[CONF_ID])
     await cg.register_component(var, config)
     await cover.register_cover(var, config)
     await uart.register_uart_device(var, config)
+    cg.add(var.set_loop_budget(config[CONF_LOOP_BUDGET]))
+    cg.add(var.set_param_write_window(config[CONF_PARAM_WRITE_WINDOW]))
+    cg.add(var.set_params_max_age(config[CONF_PARAMS_MAX_AGE]))
+    cg.add(var.set_tx_min_gap(config[CONF_TX_MIN_GAP]))
+    cg.add(var.set_tx_wait_ack(config[CONF_TX_WAIT_ACK]))
+    cg.add(var.set_poll_intervals(config[CONF_POLL_INTERVAL_FAST],
+                                  config[CONF_POLL_INTERVAL_CRUISE],
+                                  config[CONF_POLL_INTERVAL_IDLE]))
+    cg.add(var.set_interpolation_interval(config[CONF_INTERPOLATION_INTERVAL]))
+    cg.add(var.set_link_timeout(config[CONF_LINK_TIMEOUT]))
+    cg.add(var.set_idle_sleep(config[CONF_IDLE_SLEEP]))
+    cg.add_define("GATEPRO_RX_RING_SIZE", config[CONF_RX_BUFFER_SIZE])
+    cg.add_define("GATEPRO_TX_QUEUE_DEPTH", config[CONF_TX_QUEUE_DEPTH])
+    cg.add_define("GATEPRO_SOURCE_ID", cg.RawExpression(f'"{config[CONF_SOURCE_ID]}"'))
+    if CONF_GATEPRO_HUB_ID in config:
+      hub = await cg.get_variable(config[CONF_GATEPRO_HUB_ID])
+      cg.add(hub.register_gate(var))
     # switches
     for k, v in SWITCHES.items():
       if k in config:
@@ -177,7 +392,11 @@ async def to_code(config):
          sw = cg.new_Pvariable(conf[CONF_ID])
          await cg.register_component(sw, conf)
          await switch.register_switch(sw, conf)
-         cg.add(var.set_switch(v, sw))
+         desc = f"{conf[CONF_ID].id}_desc"
+         cg.add_global(cg.RawStatement(
+            f"static constexpr {GateProSwitchDesc} {desc}{{{v}, 1, 0}};"
+         ))
+         cg.add(var.set_switch(sw, cg.RawExpression(f"&{desc}")))
 
    # buttons
     for k, v in BUTTONS.items():
@@ -186,7 +405,7 @@ async def to_code(config):
          btn = cg.new_Pvariable(conf[CONF_ID])
          await cg.register_component(btn, conf)
          await button.register_button(btn, conf)
-         cg.add(var.set_button(btn, v))
+         cg.add(var.set_button(btn, getattr(gatepro_ns, v)))
 
     # selects
     for k, v in SELECTS.items():
@@ -196,7 +415,17 @@ async def to_code(config):
          values = v["values"]
          sel = await select.new_select(conf, options=options)
          await cg.register_component(sel, conf)
-         cg.add(var.set_select(sel, v["idx"], options, values))
+         # labels & raw values stay in flash, the component only keeps a pointer
+         name = conf[CONF_ID].id
+         labels = ", ".join(cpp_string_escape(o) for o in options)
+         raw = ", ".join(str(x) for x in values)
+         cg.add_global(cg.RawStatement(
+            f"static constexpr const char *const {name}_options[] = {{{labels}}};\n"
+            f"static constexpr int16_t {name}_values[] = {{{raw}}};\n"
+            f"static constexpr {GateProSelectDesc} {name}_desc{{"
+            f"{v['idx']}, {len(options)}, {name}_options, {name}_values}};"
+         ))
+         cg.add(var.set_select(sel, cg.RawExpression(f"&{name}_desc")))
 
     # text sensors
     if CONF_DEVINFO in config:
@@ -217,3 +446,37 @@ async def to_code(config):
       #cg.add(ts.set_entity_category(cg.EntityCategory.ENTITY_CATEGORY_DIAGNOSTIC))
       cg.add(var.set_txt_learn_status(ts))
 
+    if CONF_STATUS_RAW in config:
+      conf = config[CONF_STATUS_RAW]
+      conf[CONF_ENTITY_CATEGORY] = "diagnostic"
+      ts = await text_sensor.new_text_sensor(conf)
+      cg.add(var.set_txt_status_raw(ts))
+
+    # binary sensors
+    if CONF_MOVING in config:
+      bs = await binary_sensor.new_binary_sensor(config[CONF_MOVING])
+      cg.add(var.set_moving_binary_sensor(bs))
+
+    if CONF_OPENING in config:
+      bs = await binary_sensor.new_binary_sensor(config[CONF_OPENING])
+      cg.add(var.set_opening_binary_sensor(bs))
+
+    # sensors
+    if CONF_TIME_TO_OPEN in config:
+      sens = await sensor.new_sensor(config[CONF_TIME_TO_OPEN])
+      cg.add(var.set_time_to_open_sensor(sens))
+
+    if CONF_TIME_TO_CLOSE in config:
+      sens = await sensor.new_sensor(config[CONF_TIME_TO_CLOSE])
+      cg.add(var.set_time_to_close_sensor(sens))
+
+    if CONF_STATUS_POSITION in config:
+      sens = await sensor.new_sensor(config[CONF_STATUS_POSITION])
+      cg.add(var.set_status_position_sensor(sens))
+
+    # diagnostic sensors
+    for k, v in DIAG_SENSORS.items():
+      if k in config:
+         sens = await sensor.new_sensor(config[k])
+         cg.add(var.set_diag_sensor(sens, getattr(gatepro_ns, v["diag"])))
+
@@ -1,6 +1,13 @@
 #include "esphome/core/log.h"
 #include "gatepro.h"
 #include <vector>
+#include <cmath>
+#ifdef USE_ESP32
+#include <esp_heap_caps.h>
+#endif
+#ifdef USE_LOGGER
+#include "esphome/components/logger/logger.h"
+#endif
 
 namespace esphome {
 namespace gatepro {
@@ -8,73 +15,198 @@ namespace gatepro {
 ////////////////////////////////////
 static const char* TAG = "gatepro";
 
+static uint32_t free_heap() {
+#ifdef USE_ESP32
+   return heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+#else
+   return 0;
+#endif
+}
+
 ////////////////////////////////////////////
 // Helper / misc functions
 ////////////////////////////////////////////
 bool GatePro::read_msg() {
+   /* Measure the framing path only (logging below is allowed to allocate), and only when
+      someone looks at it. The net, signed change is summed up: other tasks allocating and
+      freeing meanwhile cancel out in the long run, a leak of the framing path doesn't.
+   */
+   const bool measure = this->diag_sensors[GATEPRO_DIAG_RX_HEAP_DELTA] != nullptr;
+   const uint32_t heap_before = measure ? free_heap() : 0;
    this->read_uart();
-   if (!this->rx_queue.size()) {
-      return false;
+   const bool found = this->rx_ring.next_frame(this->current_msg);
+   if (measure) {
+      this->diag_values[GATEPRO_DIAG_RX_HEAP_DELTA] += (int32_t) (heap_before - free_heap());
    }
-   this->current_msg = this->rx_queue.front();
-   this->rx_queue.pop();
-   return true;
+
+   if (found) {
+      this->log_frame("RX", this->current_msg);
+   }
+   return found;
 }
 
-GateProMsgType GatePro::identify_current_msg_type(
-   std::map<GateProMsgType, const GateProMsgConstant> possibilities = GateProMsgTypeMapping) {
-   for (const auto& [key, value] : possibilities) {
-      if (this->current_msg.substr(value.pos, value.len) == value.match) {
-         return key;
+GateProMsgType GatePro::identify_current_msg_type() {
+   return GateProMsgTypeTrie.match(this->current_msg);
+}
+
+GateProMsgType GatePro::identify_motor_event() {
+   // skip to the event name token, then match it in the same pass
+   uint8_t separators = 0;
+   for (size_t i = 0; i < this->current_msg.size(); i++) {
+      if (this->current_msg[i] == MOTOR_EVENT_SEPARATOR && ++separators == MOTOR_EVENT_TOKEN) {
+         return MotorEventTrie.match(this->current_msg.substr(i + 1));
       }
    }
    return GATEPRO_MSG_UNKNOWN;
 }
 
-int GatePro::get_position_percentage() {
-   const std::string percentage_string = this->current_msg.substr(STATUS_PERCENTAGE.pos,
-                                                                  STATUS_PERCENTAGE.len);
-   return stoi(percentage_string, 0, 16);
+bool GatePro::parse_status(GateProStatus &status) {
+   return parse_status_frame(this->current_msg, status);
 }
 
-bool GatePro::is_moving() {
-   return this->current_msg.substr(STATUS_OP_MOVING.pos,
-                                   STATUS_OP_MOVING.len) ==
-          STATUS_OP_MOVING.match;
+void GatePro::publish_status(const GateProStatus &status) {
+   if (this->moving_binary_sensor) {
+      this->moving_binary_sensor->publish_state(status.moving());
+   }
+   if (this->opening_binary_sensor) {
+      this->opening_binary_sensor->publish_state(status.opening());
+   }
+   if (this->status_position_sensor && (!this->status_position_sensor->has_state() ||
+         this->status_position_sensor->state != status.percentage())) {
+      this->status_position_sensor->publish_state(status.percentage());
+   }
+   if (this->txt_status_raw) {
+      char raw[STATUS_BYTES * 3];
+      size_t len = 0;
+      for (size_t i = 0; i < status.count; i++) {
+         len += snprintf(raw + len, sizeof(raw) - len, i ? ",%02X" : "%02X", status.bytes[i]);
+      }
+      if (this->txt_status_raw->state != raw) {
+         this->txt_status_raw->publish_state(raw);
+      }
+   }
 }
 
-std::string GatePro::convert(uint8_t* bytes, size_t len) {
-	std::string res;
-	char buf[5];
-	for (size_t i = 0; i < len; i++) {
-      auto cm = ConversionMap.find(bytes[i]);
-      if (cm != ConversionMap.end()) {
-         res += cm->second;
-		} else if (bytes[i] < 32 || bytes[i] > 127) {
-			sprintf(buf, "\\x%02X", bytes[i]);
-			res += buf;
-		} else {
-			res += bytes[i];
-		}
-	}
-	//ESP_LOGD(TAG, "%s", res.c_str());
-	return res;
+/* Frames are parsed raw, the escaped form is only rendered (on the stack) when
+   it's actually going to be logged
+*/
+void GatePro::log_frame(const char *dir, std::string_view frame) {
+#if ESPHOME_LOG_LEVEL >= ESPHOME_LOG_LEVEL_DEBUG
+#ifdef USE_LOGGER
+   if (logger::global_logger == nullptr ||
+         logger::global_logger->get_log_level() < ESPHOME_LOG_LEVEL_DEBUG) {
+      return;
+   }
+#endif
+   char buf[LOG_FRAME_SIZE];
+   size_t pos = 0;
+   for (const char c : frame) {
+      const uint8_t byte = c;
+      char hex[5];
+      const char *esc = escape_sequence(byte);
+      if (!esc && (byte < 32 || byte > 127)) {
+         snprintf(hex, sizeof(hex), "\\x%02X", byte);
+         esc = hex;
+      }
+      const size_t len = esc ? strlen(esc) : 1;
+      if (pos + len >= sizeof(buf)) {
+         break;
+      }
+      if (esc) {
+         memcpy(buf + pos, esc, len);
+      } else {
+         buf[pos] = c;
+      }
+      pos += len;
+   }
+   buf[pos] = '\0';
+   ESP_LOGD(TAG, "UART %s: %s", dir, buf);
+#endif
 }
 
 ////////////////////////////////////////////
 // Device logic
 ////////////////////////////////////////////
 void GatePro::queue_gatepro_cmd(GateProCmd cmd) {
-   ESP_LOGD(TAG, "Queuing cmd: %s", GateProCmdMapping.at(cmd));
-   this->tx_queue.push(GateProCmdMapping.at(cmd));
+   ESP_LOGD(TAG, "Queuing cmd: %s", GateProCmdDefs[cmd].name);
+   this->queue_tx(cmd, -1);
+}
+
+bool GatePro::queue_tx(GateProCmd cmd, int8_t slot) {
+   const GateProTxPriority prio = GateProCmdSpecs[cmd].prio;
+   auto &queue = this->tx_queues[prio];
+   // an identical status read already waiting will answer this one too
+   if (prio == GATEPRO_TX_PRIO_POLL && slot < 0) {
+      for (size_t i = 0; i < queue.size(); i++) {
+         if (queue[i].cmd == cmd) {
+            return true;
+         }
+      }
+   }
+
+   // resending an older motion command still waiting for its ACK would undo this one
+   if (prio == GATEPRO_TX_PRIO_MOTION) {
+      this->supersede_in_flight_motion();
+   }
+   // a STOP supersedes whatever motion is still waiting (counted as dropped), and so always finds room
+   if (cmd == GATEPRO_CMD_STOP) {
+      if (!queue.empty()) {
+         ESP_LOGD(TAG, "STOP supersedes %u queued motion commands", (unsigned) queue.size());
+      }
+      for (size_t i = 0; i < queue.size(); i++) {
+         this->drop_tx_entry(queue[i]);
+      }
+      queue.clear();
+   }
+
+   /* Drop policy on a full queue:
+      * polls are mere snapshots, the oldest one makes room for the new
+      * params and other motion commands are never evicted, a new one is refused instead
+        (a full motion queue means the caller is far ahead of the gate anyway)
+   */
+   if (queue.full() && prio == GATEPRO_TX_PRIO_POLL) {
+      ESP_LOGD(TAG, "TX queue full, dropping %s", GateProCmdDefs[queue.front().cmd].name);
+      this->drop_tx_entry(queue.front());
+      queue.pop_front();
+   }
+   const TxEntry entry{cmd, slot, micros(), 0};
+   this->wake();
+   if (!queue.push_back(entry)) {
+      ESP_LOGE(TAG, "TX queue full, %s not sent", GateProCmdDefs[cmd].name);
+      this->drop_tx_entry(entry);
+      return false;
+   }
+
+   size_t queued = 0;
+   for (const auto &q : this->tx_queues) {
+      queued += q.size();
+   }
+   if (queued > this->diag_values[GATEPRO_DIAG_TX_HIGH_WATER]) {
+      this->diag_values[GATEPRO_DIAG_TX_HIGH_WATER] = queued;
+   }
+   return true;
+}
+
+void GatePro::drop_tx_entry(const TxEntry &entry) {
+   this->diag_values[GATEPRO_DIAG_TX_DROPPED]++;
+   if (entry.cmd == GATEPRO_CMD_READ_STATUS) {
+      this->rs_outstanding = false;
+   }
+   this->release_tx_entry(entry);
 }
 
 void GatePro::control(const cover::CoverCall &call) {
+   // link loss is only a guess, a STOP goes out regardless: the controller may well get it
    if (call.get_stop()) {
       this->start_direction_(cover::COVER_OPERATION_IDLE);
       return;
    }
 
+   if (!this->link_up) {
+      ESP_LOGW(TAG, "Controller unreachable, ignoring cover call");
+      return;
+   }
+
    if (call.get_position().has_value()) {
       auto pos = *call.get_position();
       if (pos == this->position) {
@@ -97,6 +229,7 @@ void GatePro::start_direction_(cover::CoverOperation dir) {
             break;
          }
          this->queue_gatepro_cmd(GATEPRO_CMD_STOP);
+         this->stop_queued_at = millis();
          break;
       case cover::COVER_OPERATION_OPENING:
          // REVERT!!
@@ -116,15 +249,301 @@ void GatePro::start_direction_(cover::CoverOperation dir) {
    }
 }
 
-void GatePro::stop_at_target_position() {
+/* Status poller: exactly one RS is outstanding at a time, the next one is only
+   armed once the previous got answered or timed out. This way polls can't pile
+   up behind a slow controller and go out long after the motion ended.
+*/
+bool GatePro::poll_status() {
+   if (this->rs_outstanding) {
+      return false;
+   }
+   this->rs_outstanding = true;
+   if (this->current_operation != cover::COVER_OPERATION_IDLE) {
+      this->operation_polls++;
+   }
+   this->queue_gatepro_cmd(GATEPRO_CMD_READ_STATUS);
+   return true;
+}
+
+// a param selecting one of count table entries, count when it's unknown or out of range
+size_t GatePro::param_option(size_t idx, size_t count) {
+   if (idx >= this->params_count || this->params[idx] < 0 || (size_t) this->params[idx] >= count) {
+      return count;
+   }
+   return this->params[idx];
+}
+
+float GatePro::param_fraction(size_t idx, const float *fractions, size_t count, float fallback) {
+   const size_t option = this->param_option(idx, count);
+   return option < count ? fractions[option] : fallback;
+}
+
+/* The poll rate follows where precision matters:
+   * idle: slow, only to keep an eye on the controller
+   * close to a partial target, or to the deceleration zone before an end stop: fast
+   * cruising in between: slow
+   The "close" window scales with the configured operational speed, a faster
+   gate covers more distance between two polls.
+*/
+uint32_t GatePro::poll_interval() {
+   if (this->current_operation == cover::COVER_OPERATION_IDLE) {
+      return this->poll_interval_idle;
+   }
+
+   const float speed = this->param_fraction(PARAM_IDX_OPERATIONAL_SPEED, OPERATIONAL_SPEEDS, SPEED_SETTINGS,
+                                            DEFAULT_OPERATIONAL_SPEED);
+   const float decel = this->param_fraction(PARAM_IDX_DECEL_DIST, DECEL_DISTS, DECEL_SETTINGS, DEFAULT_DECEL_DIST);
+   // the learned speed beats the rough table
+   const float learned = this->current_speed();
+   const float window = learned ? learned * POLL_NEAR_TIME_S : POLL_NEAR_WINDOW * speed;
+
    if (this->target_position_ &&
          this->target_position_ != cover::COVER_OPEN &&
-         this->target_position_ != cover::COVER_CLOSED) {
-      const float diff = abs(this->position - this->target_position_);
-      if (diff < ACCEPTABLE_DIFF) {
-         this->make_call().set_command_stop().perform();
+         this->target_position_ != cover::COVER_CLOSED &&
+         std::fabs(this->position - this->target_position_) < window) {
+      return this->poll_interval_fast;
+   }
+
+   const bool opening = this->current_operation == cover::COVER_OPERATION_OPENING;
+   const float travelled = opening ? this->position : cover::COVER_OPEN - this->position;
+   if (travelled > decel - window) {
+      return this->poll_interval_fast;
+   }
+   return this->poll_interval_cruise;
+}
+
+void GatePro::schedule_poll() {
+   const uint32_t interval = this->poll_interval();
+   if (!interval || millis() - this->last_poll_at < interval) {
+      return;
+   }
+   if (this->scheduled_poll()) {
+      this->last_poll_at = millis();
+   }
+}
+
+// a poll of our own choosing (not a reply to something), the hub arbitrates those between its gates
+bool GatePro::scheduled_poll() {
+   if (this->rs_outstanding) {
+      return false;
+   }
+   if (this->hub && !this->hub->request_poll(this)) {
+      return false;
+   }
+   return this->poll_status();
+}
+
+/* Link watchdog: any frame counts as a sign of life. A quiet controller is probed
+   with RS, and once nothing came back for the whole timeout the link is lost:
+   the component goes into error and pending commands are dropped rather than
+   sent into the void. Lost links keep being probed at the cruise rate.
+*/
+void GatePro::check_link() {
+   if (!this->link_timeout) {
+      return;
+   }
+   const uint32_t quiet = millis() - this->last_rx_at;
+   if (this->link_up && quiet >= this->link_timeout) {
+      ESP_LOGW(TAG, "No frames from the controller for %ums, link lost", (unsigned) quiet);
+      this->link_up = false;
+      this->status_set_error("No response from the controller");
+      this->flush_tx();
+   }
+
+   const uint32_t probe_after = this->link_up ? this->link_timeout / 2 : this->poll_interval_cruise;
+   if (quiet >= probe_after && millis() - this->last_poll_at >= probe_after && this->scheduled_poll()) {
+      this->last_poll_at = millis();
+   }
+}
+
+// traffic resumed after a lost link: resync the state that may have changed meanwhile
+void GatePro::link_received() {
+   this->last_rx_at = millis();
+   this->diag_values[GATEPRO_DIAG_FRAMES_SEEN]++;
+   if (this->link_up) {
+      return;
+   }
+   ESP_LOGI(TAG, "Controller is back, resyncing");
+   this->link_up = true;
+   this->status_clear_error();
+   this->poll_status();
+   this->queue_gatepro_cmd(GATEPRO_CMD_READ_PARAMS);
+}
+
+/* Idle mode: with the gate at rest, nothing queued, in flight or half received,
+   every loop() would only find an empty UART. Instead the loop is disabled, and
+   a light check wakes it once bytes arrive or the next scheduled work (idle
+   poll, link probe) is due. Queuing a command wakes it right away.
+*/
+bool GatePro::idle() {
+   if (!this->idle_sleep || this->in_motion() || !this->link_up || this->rs_outstanding ||
+         this->rx_ring.size() || this->available() || this->in_flight_count()) {
+      return false;
+   }
+   for (const auto &queue : this->tx_queues) {
+      if (!queue.empty()) {
+         return false;
+      }
+   }
+   for (const auto &txn : this->param_txns) {
+      if (txn.state != GATEPRO_PARAM_TXN_FREE) {
+         return false;
+      }
+   }
+   return true;
+}
+
+void GatePro::sleep() {
+   const uint32_t now = millis();
+   // earliest of the idle poll and the link probe, none if both are disabled
+   uint32_t wait = UINT32_MAX;
+   if (this->poll_interval_idle) {
+      const uint32_t since = now - this->last_poll_at;
+      wait = since < this->poll_interval_idle ? this->poll_interval_idle - since : 0;
+   }
+   if (this->link_timeout) {
+      const uint32_t since = now - this->last_rx_at;
+      const uint32_t probe_after = this->link_timeout / 2;
+      wait = std::min(wait, since < probe_after ? probe_after - since : 0);
+   }
+   if (!wait) {
+      return;
+   }
+   this->wake_at = wait == UINT32_MAX ? 0 : now + wait;
+   this->sleeping = true;
+   this->slept_at = now;
+   // the hub checks its sleeping gates itself, and sleeps once they all do
+   if (!this->hub) {
+      this->disable_loop();
+      this->set_interval("idle_wake", IDLE_WAKE_CHECK_MS, [this]() {
+         if (this->wake_due()) {
+            this->wake();
+         }
+      });
+   }
+}
+
+bool GatePro::wake_due() {
+   return this->available() || (this->wake_at && (int32_t) (millis() - this->wake_at) >= 0);
+}
+
+void GatePro::wake() {
+   if (!this->sleeping) {
+      return;
+   }
+   this->sleeping = false;
+   this->slept_ms += millis() - this->slept_at;
+   if (this->hub) {
+      this->hub->wake();
+      return;
+   }
+   this->cancel_interval("idle_wake");
+   this->enable_loop();
+}
+
+void GatePro::flush_tx() {
+   for (auto &queue : this->tx_queues) {
+      for (size_t i = 0; i < queue.size(); i++) {
+         this->release_tx_entry(queue[i]);
+      }
+      queue.clear();
+   }
+   for (auto &in : this->in_flight) {
+      if (in.active) {
+         in.active = false;
+         this->release_tx_entry(in.entry);
       }
    }
+   this->rs_outstanding = false;
+   // a STOP dropped here never reaches the controller, there's no latency to measure
+   this->stop_queued_at = 0;
+}
+
+void GatePro::cancel_status_polls() {
+   auto &queue = this->tx_queues[GateProCmdSpecs[GATEPRO_CMD_READ_STATUS].prio];
+   queue.remove_if([](const TxEntry &entry) { return entry.cmd == GATEPRO_CMD_READ_STATUS; });
+   for (auto &in : this->in_flight) {
+      if (in.active && in.entry.cmd == GATEPRO_CMD_READ_STATUS) {
+         in.active = false;
+      }
+   }
+   this->rs_outstanding = false;
+
+   // the operation is over
+   this->diag_values[GATEPRO_DIAG_POLLS_PER_OPERATION] = this->operation_polls;
+   this->operation_polls = 0;
+}
+
+/* Evaluated on every RS sample. The gate keeps moving while the STOP travels to
+   the controller and the motor brakes, so the stop is triggered early by the
+   distance covered during the measured STOP latency. As the next sample only
+   comes a poll later, the stop is also issued if waiting for it would take the
+   gate (on average) further than stopping right now.
+*/
+void GatePro::stop_at_target_position() {
+   if (!this->target_position_ ||
+         this->target_position_ == cover::COVER_OPEN ||
+         this->target_position_ == cover::COVER_CLOSED ||
+         this->current_operation == cover::COVER_OPERATION_IDLE ||
+         this->stop_target) {
+      return;
+   }
+
+   const bool opening = this->current_operation == cover::COVER_OPERATION_OPENING;
+   const float remaining = opening ? this->target_position_ - this->position
+                                   : this->position - this->target_position_;
+   const float speed = this->current_speed();
+   bool stop;
+   if (speed) {
+      const float lead = speed * this->stop_latency_ms / 1000;
+      const float next_sample = speed * this->poll_interval_fast / 1000;
+      stop = remaining - lead <= next_sample / 2;
+   } else {
+      // nothing known about the speed yet
+      stop = remaining < ACCEPTABLE_DIFF;
+   }
+   if (!stop) {
+      return;
+   }
+
+   ESP_LOGD(TAG, "Stopping for target %.2f at %.2f", this->target_position_, this->position);
+   this->stop_target = this->target_position_;
+   this->stop_opening = opening;
+   this->make_call().set_command_stop().perform();
+}
+
+void GatePro::stop_finished() {
+   if (this->stop_queued_at) {
+      const uint32_t latency = millis() - this->stop_queued_at;
+      if (latency <= STOP_LATENCY_MAX_MS) {
+         this->stop_latency_ms += STOP_LATENCY_EMA_ALPHA * ((float) latency - this->stop_latency_ms);
+         this->diag_values[GATEPRO_DIAG_STOP_LATENCY] = this->stop_latency_ms;
+      } else {
+         ESP_LOGD(TAG, "Ignoring STOP latency of %u ms", (unsigned) latency);
+      }
+      this->stop_queued_at = 0;
+   }
+   if (this->stop_target) {
+      // the position the gate came to rest at is only known from the next RS
+      this->overshoot_pending = true;
+      this->poll_status();
+   }
+}
+
+void GatePro::record_overshoot() {
+   if (!this->overshoot_pending) {
+      return;
+   }
+   // positive: went past the target
+   const float overshoot = (this->stop_opening ? this->position - this->stop_target
+                                               : this->stop_target - this->position) * 100;
+   this->overshoot_count++;
+   this->overshoot_abs_sum += std::fabs(overshoot);
+   this->diag_values[GATEPRO_DIAG_STOP_OVERSHOOT] = overshoot;
+   this->diag_values[GATEPRO_DIAG_STOP_OVERSHOOT_AVG] = this->overshoot_abs_sum / this->overshoot_count;
+   ESP_LOGD(TAG, "Stopped %.1f%% past target", overshoot);
+   this->overshoot_pending = false;
+   this->stop_target = 0.0f;
 }
 
 /* The gate physically doesn't always move literally from 0% to 100%.
@@ -151,24 +570,39 @@ void GatePro::correction_after_operation() {
    }
 }
 
-void GatePro::process() {
+bool GatePro::process() {
    // try reading a message from uart
    if (!this->read_msg()) {
-      return;
+      return false;
    }
+   this->handle_msg();
+   return true;
+}
+
+void GatePro::handle_msg() {
+   this->link_received();
    GateProMsgType current_msg_type = this->identify_current_msg_type();
+   this->ack_received(current_msg_type);
    switch (current_msg_type) {
       case GATEPRO_MSG_UNKNOWN:
+         this->diag_values[GATEPRO_DIAG_UNKNOWN_FRAMES]++;
          ESP_LOGD(TAG, "Unkown message type");
          return;
 
       case GATEPRO_MSG_ACK_RS: {
-         // status only matters when in motion (operation not finished) 
+         GateProStatus status;
+         if (!this->parse_status(status)) {
+            ESP_LOGW(TAG, "Malformed status");
+            return;
+         }
+         this->publish_status(status);
+
+         // position only matters when in motion (operation not finished) 
          if (this->operation_finished) {
             return;
          }
 
-         int percentage = this->get_position_percentage();
+         int percentage = status.raw_percentage();
          /* The following logic is necessary for startup: We have to somehow be able to identify
             the current state. The only known possible method is this logic:
             * if percentage is above 100, it's offset by the constant that's applied when opening;
@@ -182,7 +616,7 @@ void GatePro::process() {
             this->current_operation = cover::COVER_OPERATION_OPENING;
             this->last_operation_ = cover::COVER_OPERATION_OPENING;
             this->operation_finished = false;
-         } else if (this->is_moving()) {
+         } else if (status.moving()) {
             this->current_operation = cover::COVER_OPERATION_CLOSING;
             this->last_operation_ = cover::COVER_OPERATION_CLOSING;
             this->operation_finished = false;
@@ -196,15 +630,25 @@ void GatePro::process() {
          */
          percentage = clamp(percentage, 1, 99);
          this->position = (float)percentage / 100;
+         this->motion_sample();
+         this->record_overshoot();
+         this->stop_at_target_position();
          return;
       }
 
       case GATEPRO_MSG_ACK_RP:
-         this->parse_params();
+         if (!this->parse_params()) {
+            ESP_LOGW(TAG, "Malformed params, ignoring");
+         }
+         return;
+
+      case GATEPRO_MSG_ACK_WP:
+         ESP_LOGD(TAG, "Params written");
+         this->params_written();
          return;
 
       case GATEPRO_MSG_MOTOR_EVENT: {
-         GateProMsgType motor_event = this->identify_current_msg_type(MotorEvents);
+         GateProMsgType motor_event = this->identify_motor_event();
          switch(motor_event) {
             case GATEPRO_MSG_UNKNOWN:
                ESP_LOGD(TAG, "Unkown motor event");
@@ -212,9 +656,11 @@ void GatePro::process() {
 
             case MOTOR_EVENT_OPENING:
             case MOTOR_EVENT_PED_OPENING:
+               this->confirm_in_flight(motor_event == MOTOR_EVENT_OPENING ? GATEPRO_CMD_OPEN : GATEPRO_CMD_PED_OPEN);
                this->operation_finished = false;
                this->current_operation = cover::COVER_OPERATION_OPENING;
                this->last_operation_ = cover::COVER_OPERATION_OPENING;
+               this->motion_started();
                return;
             
             case MOTOR_EVENT_OPENED:
@@ -222,19 +668,25 @@ void GatePro::process() {
                this->target_position_ = 0.0f;
                this->current_operation = cover::COVER_OPERATION_IDLE;
                this->position = cover::COVER_OPEN;
+               this->motion_finished();
+               this->cancel_status_polls();
                return;
 
             case MOTOR_EVENT_PED_OPENED:
                this->operation_finished = true;
                this->target_position_ = 0.0f;
                this->current_operation = cover::COVER_OPERATION_IDLE;
+               this->anchored = false;
+               this->cancel_status_polls();
                return;
             
             case MOTOR_EVENT_CLOSING:
             case MOTOR_EVENT_AUTOCLOSING:
+               this->confirm_in_flight(GATEPRO_CMD_CLOSE);
                this->operation_finished = false;
                this->current_operation = cover::COVER_OPERATION_CLOSING;
                this->last_operation_ = cover::COVER_OPERATION_CLOSING;
+               this->motion_started();
                return;
 
             case MOTOR_EVENT_CLOSED:
@@ -242,115 +694,527 @@ void GatePro::process() {
                this->target_position_ = 0.0f;
                this->current_operation = cover::COVER_OPERATION_IDLE;
                this->position = cover::COVER_CLOSED;
+               this->motion_finished();
+               this->cancel_status_polls();
                return;
                
             case MOTOR_EVENT_STOPPED:
+               this->confirm_in_flight(GATEPRO_CMD_STOP);
                this->target_position_ = 0.0f;
                this->current_operation = cover::COVER_OPERATION_IDLE;
+               this->anchored = false;
+               this->cancel_status_polls();
+               this->stop_finished();
                return;            
          }
          return; // should never reach here.. but just to be safe..
       }
 
       case GATEPRO_MSG_ACK_READ_DEVINFO:
-         if (!this->txt_devinfo)
-            return;
-         this->txt_devinfo->publish_state(this->current_msg.substr(17, this->current_msg.size() - (17 + 4)));
-         return;
-
-      case GATEPRO_MSG_ACK_LEARN_STATUS:
-         if (!this->txt_learn_status)
+      case GATEPRO_MSG_ACK_LEARN_STATUS: {
+         // a truncated frame must not reach substr(), it would throw
+         if (this->current_msg.size() < INFO_START) {
+            ESP_LOGW(TAG, "Truncated info frame, ignoring");
             return;
-         this->txt_learn_status->publish_state(this->current_msg.substr(17, this->current_msg.size() - (17 + 4)));
+         }
+         const std::string_view info = this->current_msg.substr(INFO_START);
+         if (current_msg_type == GATEPRO_MSG_ACK_READ_DEVINFO) {
+            this->update_text_info(this->txt_devinfo, this->persisted.devinfo, info);
+         } else {
+            this->update_text_info(this->txt_learn_status, this->persisted.learn_status, info);
+         }
          return;
+      }
    } 
 }
 
+////////////////////////////////////////////
+// Motion model
+////////////////////////////////////////////
+/* Dead reckoning between RS samples: the travel speed is learned per direction
+   and per operational speed setting, from consecutive RS samples and from full
+   travels (motor event timestamps). Between samples the position is extrapolated
+   from the last sample (the anchor), every real sample corrects it.
+*/
+size_t GatePro::speed_setting() {
+   // unknown: taken for the fastest setting, as DEFAULT_OPERATIONAL_SPEED is
+   const size_t option = this->param_option(PARAM_IDX_OPERATIONAL_SPEED, SPEED_SETTINGS);
+   return option < SPEED_SETTINGS ? option : SPEED_SETTINGS - 1;
+}
+
+float &GatePro::learned_speed() {
+   const size_t dir = this->last_operation_ == cover::COVER_OPERATION_CLOSING ? 1 : 0;
+   return this->learned_speeds[dir][this->speed_setting()];
+}
+
+void GatePro::learn_speed(float speed) {
+   float &learned = this->learned_speed();
+   learned = learned ? learned + SPEED_EMA_ALPHA * (speed - learned) : speed;
+}
+
+void GatePro::motion_started() {
+   // a stop that never got confirmed doesn't block the next one, nor is its latency measured
+   this->stop_target = 0.0f;
+   this->stop_queued_at = 0;
+   this->overshoot_pending = false;
+   this->op_start_position = this->position;
+   this->op_start_at = millis();
+   this->anchor_position = this->position;
+   this->anchor_at = this->op_start_at;
+   this->anchored = true;
+}
+
+void GatePro::motion_sample() {
+   const uint32_t now = millis();
+   if (this->anchored && this->current_operation != cover::COVER_OPERATION_IDLE &&
+         now - this->anchor_at >= SPEED_SAMPLE_MIN_MS) {
+      const float travelled = std::fabs(this->position - this->anchor_position);
+      if (travelled > 0) {
+         this->learn_speed(travelled * 1000 / (now - this->anchor_at));
+      }
+   }
+   this->anchor_position = this->position;
+   this->anchor_at = now;
+   this->anchored = this->current_operation != cover::COVER_OPERATION_IDLE;
+}
+
+// reaching an end stop after a tracked start gives the average speed of the whole travel
+void GatePro::motion_finished() {
+   if (this->anchored && this->op_start_at) {
+      const uint32_t duration = millis() - this->op_start_at;
+      const float travelled = std::fabs(this->position - this->op_start_position);
+      if (duration >= SPEED_SAMPLE_MIN_MS && travelled > 0) {
+         this->learn_speed(travelled * 1000 / duration);
+         this->learn_travel_time(duration, travelled);
+      }
+   }
+   this->op_start_at = 0;
+   this->anchored = false;
+   // the gate came to rest on its own, a pending STOP didn't do it
+   this->stop_queued_at = 0;
+}
+
+float GatePro::current_speed() {
+   const float speed = this->learned_speed();
+   if (speed) {
+      return speed;
+   }
+   // nothing learned for this speed setting yet, the travel profile is the next best thing
+   const float travel_s = this->last_operation_ == cover::COVER_OPERATION_CLOSING ? this->travel.close_s
+                                                                                   : this->travel.open_s;
+   return travel_s ? 1 / travel_s : 0;
+}
+
+void GatePro::interpolate_position() {
+   if (!this->interpolation_interval || !this->anchored ||
+         this->current_operation == cover::COVER_OPERATION_IDLE) {
+      return;
+   }
+   const uint32_t now = millis();
+   if (now - this->last_interpolation_at < this->interpolation_interval) {
+      return;
+   }
+   this->last_interpolation_at = now;
+
+   const float speed = this->current_speed();
+   if (!speed) {
+      return;
+   }
+   const float travelled = speed * (now - this->anchor_at) / 1000;
+   const float estimate = this->current_operation == cover::COVER_OPERATION_OPENING
+                             ? this->anchor_position + travelled
+                             : this->anchor_position - travelled;
+   // end positions are only ever confirmed by the motor events
+   this->position = clamp(estimate, 0.01f, 0.99f);
+   if (this->position != this->position_) {
+      this->position_ = this->position;
+      this->publish_state();
+   }
+}
+
+/* Travel time profile: full open / close durations, learned from the motor event
+   timestamps of every long enough travel and kept across reboots. Automations and
+   the interpolator can use it without ever polling the controller.
+*/
+void GatePro::restore_travel_profile() {
+   this->travel_pref = global_preferences->make_preference<GateProTravelProfile>(
+      this->get_object_id_hash() ^ TRAVEL_PROFILE_VERSION);
+   if (!this->travel_pref.load(&this->travel) || !(this->travel.open_s >= 0) || !(this->travel.close_s >= 0)) {
+      this->travel = GateProTravelProfile{};
+      return;
+   }
+   ESP_LOGD(TAG, "Restored travel profile: open %.1fs, close %.1fs", this->travel.open_s, this->travel.close_s);
+}
+
+void GatePro::learn_travel_time(uint32_t duration, float travelled) {
+   if (travelled < TRAVEL_MIN_FRACTION) {
+      return;
+   }
+   float &travel_s = this->last_operation_ == cover::COVER_OPERATION_CLOSING ? this->travel.close_s
+                                                                              : this->travel.open_s;
+   const float measured = duration / 1000.0f / travelled;
+   travel_s = travel_s ? travel_s + TRAVEL_EMA_ALPHA * (measured - travel_s) : measured;
+   this->travel_pref.save(&this->travel);
+}
+
+void GatePro::publish_eta() {
+   struct {
+      sensor::Sensor *sens;
+      float travel_s;
+      float remaining;
+   } etas[] = {
+      {this->time_to_open_sensor, this->travel.open_s, cover::COVER_OPEN - this->position},
+      {this->time_to_close_sensor, this->travel.close_s, this->position - cover::COVER_CLOSED},
+   };
+   for (const auto &eta : etas) {
+      if (!eta.sens || !eta.travel_s) {
+         continue;
+      }
+      const float value = eta.travel_s * eta.remaining;
+      if (eta.sens->has_state() && std::fabs(eta.sens->state - value) < ETA_RESOLUTION_S) {
+         continue;
+      }
+      eta.sens->publish_state(value);
+   }
+}
+
 ////////////////////////////////////////////
 // Parameters
 ////////////////////////////////////////////
 /* Working with params is really complicated:
    * there's no known & working method of changing a single param,
      => always have to write, and thus know, all other params back too
-   * at first, we have no idea of params and whether they're changed or not
-     so we start with reading them out
-   * at the same time, we create a task in a task queue that
-     "in the future" (after we will have read the current params):
-         * overwrites the requested param index with requested value
-         * initiates writing this modified param list back to the device
-   * once the devices replies with the current params list, the process
-     identifies this as a RP (read param) msg type, and executes parsing
-     and thus filling up our internal (current) param list
-   * and finally, executes the previously mentioned tasks from the queue
-   * in the end, we simply build & queue the WP (write params) msg,
-     that eventually gets sent to the device, and also update our sensors
+   * changes requested within a short window are collected and handled
+     as one transaction, so e.g. 3 select changes cost a single write
+   * unless our cached params are fresh, we have no idea whether they're
+     changed or not, so we start with reading them out
+
+   Every edit is a record in a fixed pool, moving through these states:
+     PENDING: collected until the write window closes; a newer edit of the
+              same index simply overwrites the value
+     READING: RP queued, the edit is applied once the params arrive
+     WRITING: applied and WP queued, done once the ACK WP arrives
+   Only one transaction is READING / WRITING at a time, so overlapping
+   edits go out in the order they were made. A transaction whose RP or
+   ACK WP doesn't arrive in time fails: its records are freed and the
+   entities get republished with whatever the controller reports next.
+*/
+
+/* Only entities whose param changed since the last publish are updated, an RP
+   that just confirms the known state doesn't generate any API traffic
 */
 void GatePro::publish_params() {
-   if (!this->param_no_pub) {
-      // Switches
-      for (auto swi : this->switches_with_indices) {
-         swi.switch_->publish_state(this->params[swi.idx]);
+   // entities of params being edited already show the requested value
+   const uint32_t editing = this->params_in(GATEPRO_PARAM_TXN_PENDING) |
+                            this->params_in(GATEPRO_PARAM_TXN_READING) |
+                            this->params_in(GATEPRO_PARAM_TXN_WRITING);
+   uint32_t changed = 0;
+   for (size_t i = 0; i < this->params_count; i++) {
+      if (!(this->published_mask & (1u << i)) || this->published_params[i] != this->params[i]) {
+         changed |= 1u << i;
+      }
+   }
+   changed &= ~editing;
+
+   // Switches
+   for (const auto &swi : this->switches_with_desc) {
+      const size_t idx = swi.desc->idx;
+      if (idx >= this->params_count) {
+         continue;
       }
-      // Selects
-      for (auto swd : this->select_with_data) {
-         swd.select->publish_state(swd.options[this->params[swd.idx]]);
+      if (!(changed & (1u << idx))) {
+         this->diag_values[GATEPRO_DIAG_SUPPRESSED_PUBLISHES]++;
+         continue;
+      }
+      swi.switch_->publish_state(this->params[idx] != swi.desc->off_value);
+   }
+   // Selects
+   for (const auto &swd : this->selects_with_desc) {
+      const size_t idx = swd.desc->idx;
+      const size_t option = idx < this->params_count ? swd.desc->index_of(this->params[idx]) : swd.desc->count;
+      if (option == swd.desc->count) {
+         continue;
+      }
+      if (!(changed & (1u << idx))) {
+         this->diag_values[GATEPRO_DIAG_SUPPRESSED_PUBLISHES]++;
+         continue;
+      }
+      swd.select->publish_state(swd.desc->options[option]);
+   }
+
+   for (size_t i = 0; i < this->params_count; i++) {
+      if (!(editing & (1u << i))) {
+         this->published_params[i] = this->params[i];
+         this->published_mask |= 1u << i;
       }
    }
 }
 
-void GatePro::write_params() {
-   this->params_cmd = GateProCmdMapping.at(GATEPRO_CMD_WRITE_PARAMS);
-   for (size_t i = 0; i < this->params.size(); i++) {
-      this->params_cmd += to_string(this->params[i]);
-      if (i != this->params.size() - 1) {
-         this->params_cmd += PARAMS_SEPARATOR;
+bool GatePro::write_params() {
+   const int8_t slot = this->acquire_tx_frame();
+   if (slot < 0) {
+      ESP_LOGW(TAG, "No free TX buffer, params not written");
+      return false;
+   }
+   TxFrame &frame = this->tx_pool[slot];
+   char *pos = frame.data;
+   // leave room for the delimiter
+   char *end = frame.data + sizeof(frame.data) - TX_DELIMITER_LENGTH;
+
+   // the edits being written on top of the known params, which only take them over once ACKed
+   std::array<int, PARAMS_MAX> values = this->params;
+   for (const auto &txn : this->param_txns) {
+      if (txn.state == GATEPRO_PARAM_TXN_WRITING) {
+         values[txn.idx] = txn.value;
       }
    }
 
-   ESP_LOGD(TAG, "Built params: %s", this->params_cmd.c_str());
-   this->tx_queue.push(this->params_cmd.c_str());
+   const std::string_view prefix = GateProCmds.text(GATEPRO_CMD_WRITE_PARAMS);
+   memcpy(pos, prefix.data(), prefix.size());
+   pos += prefix.size();
+   for (size_t i = 0; i < this->params_count; i++) {
+      if (i && pos < end) {
+         *pos++ = PARAMS_SEPARATOR;
+      }
+      auto [next, ec] = std::to_chars(pos, end, values[i]);
+      if (ec != std::errc()) {
+         ESP_LOGW(TAG, "Params don't fit the TX buffer, not written");
+         frame.used = false;
+         return false;
+      }
+      pos = next;
+   }
+   memcpy(pos, TX_DELIMITER, TX_DELIMITER_LENGTH);
+   frame.len = pos - frame.data + TX_DELIMITER_LENGTH;
+
+   ESP_LOGD(TAG, "Built params: %.*s", (int) (frame.len - TX_DELIMITER_LENGTH), frame.data);
+   // a refused WP already gave its buffer back
+   if (!this->queue_tx(GATEPRO_CMD_WRITE_PARAMS, slot)) {
+      return false;
+   }
 
    // read params again just to update frontend and make sure :)
    this->queue_gatepro_cmd(GATEPRO_CMD_READ_PARAMS);
+   return true;
 }
 
-void GatePro::parse_params() {
-   this->params.clear();
-   std::string msg = this->current_msg.substr(PARAMS.pos, PARAMS.len);
-   size_t start = 0;
-   size_t end;
-
-   // efficiently split on separator
-   while((end = msg.find(PARAMS_SEPARATOR, start)) != std::string::npos) {
-      this->params.push_back(stoi(msg.substr(start, end - start)));
-      start = end + 1;
+/* Parses the param list in place, without allocating or throwing. The list
+   is only taken over once the whole frame parsed fine, a garbled frame keeps
+   the previous params.
+*/
+bool GatePro::parse_params() {
+   std::array<int, PARAMS_MAX> parsed{};
+   const size_t count = parse_params_frame(this->current_msg, parsed);
+   if (!count) {
+      return false;
    }
-   this->params.push_back(stoi(msg.substr(start)));
 
+   // compared with the cache, not the live params: those may already hold our own edits
+   bool changed = count != this->persisted.params_count;
+   for (size_t i = 0; i < count && !changed; i++) {
+      changed = parsed[i] != this->persisted.params[i];
+   }
+   this->params = parsed;
+   this->params_count = count;
+   this->params_read_at = millis();
+   if (changed) {
+      this->save_state();
+   }
+   // a transaction waiting for these params goes on to write
+   this->apply_pending_params();
    this->publish_params();
+   return true;
+}
 
-   /* This is where magic happens  */
-   while (!this->paramTaskQueue.empty()) {
-      auto task = this->paramTaskQueue.front();
-      this->paramTaskQueue.pop();
-      task();
-      this->param_no_pub = false;
+uint32_t GatePro::params_in(GateProParamTxnState state) {
+   uint32_t mask = 0;
+   for (const auto &txn : this->param_txns) {
+      if (txn.state == state) {
+         mask |= 1u << txn.idx;
+      }
    }
+   return mask;
 }
 
 void GatePro::set_param(int idx, int val) {
    ESP_LOGD(TAG, "Initiating setting param %d to %d", idx, val);
-   this->param_no_pub = true;
+   if (idx < 0 || idx >= (int) PARAMS_MAX) {
+      return;
+   }
+   // the entity already shows the requested value, an RP disagreeing must republish
+   this->published_params[idx] = val;
+
+   // the write window is timed from the loop
+   this->wake();
+
+   // changes within the window are merged into one read-modify-write
+   GateProParamTxn *free_txn = nullptr;
+   uint32_t deadline = millis() + this->param_write_window;
+   for (auto &txn : this->param_txns) {
+      if (txn.state == GATEPRO_PARAM_TXN_FREE) {
+         free_txn = free_txn ? free_txn : &txn;
+         continue;
+      }
+      if (txn.state != GATEPRO_PARAM_TXN_PENDING) {
+         continue;
+      }
+      if (txn.idx == idx) {
+         txn.value = val;
+         return;
+      }
+      deadline = txn.deadline;
+   }
+   if (!free_txn) {
+      ESP_LOGW(TAG, "Too many param edits in progress, param %d not set", idx);
+      this->diag_values[GATEPRO_DIAG_PARAM_FAILURES]++;
+      this->published_mask &= ~(1u << idx);
+      return;
+   }
+   *free_txn = GateProParamTxn{GATEPRO_PARAM_TXN_PENDING, (uint8_t) idx, (int16_t) val, deadline};
+}
+
+void GatePro::commit_params() {
+   const uint32_t now = millis();
+   bool busy = false;
+   bool due = false;
+   for (const auto &txn : this->param_txns) {
+      if (txn.state == GATEPRO_PARAM_TXN_FREE) {
+         continue;
+      }
+      const bool expired = (int32_t) (now - txn.deadline) >= 0;
+      if (txn.state == GATEPRO_PARAM_TXN_PENDING) {
+         due |= expired;
+         continue;
+      }
+      if (expired) {
+         ESP_LOGW(TAG, "No %s in time, param edits failed", txn.state == GATEPRO_PARAM_TXN_READING ? "RP" : "ACK WP");
+         this->fail_params(txn.state);
+         continue;
+      }
+      busy = true;
+   }
+   if (busy || !due) {
+      return;
+   }
+
+   for (auto &txn : this->param_txns) {
+      if (txn.state == GATEPRO_PARAM_TXN_PENDING) {
+         txn.state = GATEPRO_PARAM_TXN_READING;
+         txn.deadline = now + PARAM_TXN_TIMEOUT_MS;
+      }
+   }
+   // recently read params can be modified right away, no need to read them again
+   if (this->params_read_at && now - this->params_read_at < this->params_max_age) {
+      ESP_LOGD(TAG, "Params are fresh, skipping pre-read");
+      this->apply_pending_params();
+      return;
+   }
    this->queue_gatepro_cmd(GATEPRO_CMD_READ_PARAMS);
+}
 
-   this->paramTaskQueue.push(
-      [this, idx, val](){
-         this->params[idx] = val;
-         this->write_params();
-      });
+void GatePro::apply_pending_params() {
+   bool applied = false;
+   for (auto &txn : this->param_txns) {
+      if (txn.state != GATEPRO_PARAM_TXN_READING) {
+         continue;
+      }
+      if (txn.idx >= this->params_count) {
+         ESP_LOGW(TAG, "Param %u not reported by the controller, not setting it", (unsigned) txn.idx);
+         txn.state = GATEPRO_PARAM_TXN_FREE;
+         this->diag_values[GATEPRO_DIAG_PARAM_FAILURES]++;
+         continue;
+      }
+      txn.state = GATEPRO_PARAM_TXN_WRITING;
+      txn.deadline = millis() + PARAM_TXN_TIMEOUT_MS;
+      applied = true;
+   }
+   if (applied && !this->write_params()) {
+      this->fail_params(GATEPRO_PARAM_TXN_WRITING);
+   }
+}
+
+// only one WP is out at a time, its ACK completes every edit it carried
+void GatePro::params_written() {
+   bool written = false;
+   for (auto &txn : this->param_txns) {
+      if (txn.state == GATEPRO_PARAM_TXN_WRITING) {
+         this->params[txn.idx] = txn.value;
+         txn.state = GATEPRO_PARAM_TXN_FREE;
+         written = true;
+      }
+   }
+   if (written) {
+      this->save_state();
+   }
 }
 
+void GatePro::fail_params(GateProParamTxnState state) {
+   for (auto &txn : this->param_txns) {
+      if (txn.state != state) {
+         continue;
+      }
+      txn.state = GATEPRO_PARAM_TXN_FREE;
+      // republished from the next RP, the entity must not keep showing a value never written
+      this->published_mask &= ~(1u << txn.idx);
+      this->diag_values[GATEPRO_DIAG_PARAM_FAILURES]++;
+   }
+   // a WP without ACK may have been applied all the same, the next edit has to read first
+   this->params_read_at = 0;
+   this->queue_gatepro_cmd(GATEPRO_CMD_READ_PARAMS);
+}
+
+
+
+////////////////////////////////////////////
+// Persistence
+////////////////////////////////////////////
+/* The last known params, devinfo and learn status survive reboots, so the
+   frontend is populated right at boot instead of after the first round trips.
+   They're only saved when changed, params hardly ever change so it doesn't
+   wear the flash.
+*/
+void GatePro::restore_state() {
+   this->pref = global_preferences->make_preference<GateProPersistedState>(
+      this->get_object_id_hash() ^ PERSISTED_STATE_VERSION);
+   if (!this->pref.load(&this->persisted) || this->persisted.params_count > PARAMS_MAX) {
+      this->persisted = GateProPersistedState{};
+      return;
+   }
+
+   ESP_LOGD(TAG, "Restoring %u cached params", (unsigned) this->persisted.params_count);
+   for (size_t i = 0; i < this->persisted.params_count; i++) {
+      this->params[i] = this->persisted.params[i];
+   }
+   this->params_count = this->persisted.params_count;
+   this->publish_params();
+
+   if (this->txt_devinfo && this->persisted.devinfo[0]) {
+      this->txt_devinfo->publish_state(this->persisted.devinfo);
+   }
+   if (this->txt_learn_status && this->persisted.learn_status[0]) {
+      this->txt_learn_status->publish_state(this->persisted.learn_status);
+   }
+}
+
+void GatePro::save_state() {
+   this->persisted.params_count = this->params_count;
+   for (size_t i = 0; i < this->params_count; i++) {
+      this->persisted.params[i] = this->params[i];
+   }
+   this->pref.save(&this->persisted);
+}
 
+void GatePro::update_text_info(text_sensor::TextSensor *txt, char *cache, std::string_view info) {
+   const size_t len = std::min(info.size(), PERSISTED_TEXT_SIZE - 1);
+   if (strncmp(cache, info.data(), len) != 0 || cache[len] != '\0') {
+      memcpy(cache, info.data(), len);
+      cache[len] = '\0';
+      this->save_state();
+   }
+   if (txt) {
+      txt->publish_state(std::string(info));
+   }
+}
 
 ////////////////////////////////////////////
 // Sensor logic
@@ -374,43 +1238,238 @@ void GatePro::publish() {
    this->publish_state();
 }
 
+void GatePro::publish_diag() {
+   for (size_t i = 0; i < GATEPRO_DIAG_COUNT; i++) {
+      sensor::Sensor *sens = this->diag_sensors[i];
+      if (!sens || (sens->has_state() && sens->state == this->diag_values[i])) {
+         continue;
+      }
+      sens->publish_state(this->diag_values[i]);
+   }
+}
+
 ////////////////////////////////////////////
 // UART
 ////////////////////////////////////////////
 void GatePro::read_uart() {
    // check if anything on UART buffer
-   int available = this->available();
-   if (!available) {
+   size_t available = this->available();
+
+   // read straight into the ring, in (at most two) contiguous chunks
+   while (available) {
+      size_t room;
+      uint8_t *dst = this->rx_ring.write_ptr(room);
+      if (!room) {
+         // complete frames are handed out first, the rest stays in the UART buffer until then
+         if (!this->rx_ring.exhausted()) {
+            break;
+         }
+         // a full ring without a single delimiter can only be garbage
+         ESP_LOGW(TAG, "RX ring full without a complete frame, dropping %u bytes", (unsigned) this->rx_ring.size());
+         this->diag_values[GATEPRO_DIAG_RX_DROPPED] += this->rx_ring.size();
+         this->rx_ring.clear();
+         continue;
+      }
+      const size_t len = std::min(room, available);
+      this->read_array(dst, len);
+      this->rx_ring.commit(len);
+      available -= len;
+   }
+
+   const float held = this->rx_ring.size();
+   if (held > this->diag_values[GATEPRO_DIAG_RX_HIGH_WATER]) {
+      this->diag_values[GATEPRO_DIAG_RX_HIGH_WATER] = held;
+   }
+}
+
+int8_t GatePro::acquire_tx_frame() {
+   for (size_t i = 0; i < TX_POOL_SIZE; i++) {
+      if (!this->tx_pool[i].used) {
+         this->tx_pool[i].used = true;
+         return i;
+      }
+   }
+   return -1;
+}
+
+/* Sends the next frame as soon as the link allows it: at least tx_min_gap after the
+   previous one and, if configured, once the previous one got ACKed (or the ACK timed out).
+   Motion commands wait neither for ACKs nor for tx_min_gap, only for the previous frame
+   to be clear of the wire: a STOP must not sit behind a slow or recent RS.
+*/
+void GatePro::pace_tx() {
+   const uint32_t now = millis();
+   const bool motion = !this->tx_queues[GATEPRO_TX_PRIO_MOTION].empty();
+   if (now - this->last_tx_at < (motion ? TX_MOTION_MIN_GAP_MS : this->tx_min_gap)) {
+      return;
+   }
+   if (this->tx_wait_ack && this->in_flight_count() && !motion) {
       return;
    }
-   
-   // read the whole buffer into our own buffer
-   // (if there's remainder from previous msgs, concatenate)
-   uint8_t* bytes = new uint8_t[available];
-   this->read_array(bytes, available);
-   this->msg_buff += this->convert(bytes, available);
+   if (this->write_uart()) {
+      this->last_tx_at = now;
+   }
+}
 
-   // find delimiter, thus a whole msg, send it to processor, then remove from buffer and keep remainder (if any)
-   size_t pos = this->msg_buff.find(DELIMITER);
-   if (pos != std::string::npos) {
-      std::string sub = this->msg_buff.substr(0, pos + DELIMITER_LENGTH);
-      this->rx_queue.push(sub);
-      ESP_LOGD(TAG, "UART RX[%d]: %s", this->rx_queue.size(), sub.c_str());
-      this->msg_buff = this->msg_buff.substr(pos + DELIMITER_LENGTH); //, this->msg_buff.length() - pos);
+////////////////////////////////////////////
+// Request / response correlation
+////////////////////////////////////////////
+size_t GatePro::in_flight_count() {
+   size_t count = 0;
+   for (const auto &in : this->in_flight) {
+      count += in.active;
    }
+   return count;
 }
 
-void GatePro::write_uart() {
-   if (this->tx_queue.size()) {
-      std::string tmp = this->tx_queue.front();
-      tmp += TX_DELIMITER;
-      const char* out = tmp.c_str();
-      this->write_str(out);
-      ESP_LOGD(TAG, "UART TX[%d]: %s", this->tx_queue.size(), out);
-      this->tx_queue.pop();
+void GatePro::track_in_flight(const TxEntry &entry) {
+   if (GateProCmdSpecs[entry.cmd].ack == GATEPRO_MSG_UNKNOWN) {
+      this->release_tx_entry(entry);
+      return;
+   }
+   for (auto &in : this->in_flight) {
+      if (!in.active) {
+         in.active = true;
+         in.entry = entry;
+         in.sent_at = millis();
+         return;
+      }
+   }
+   // all slots busy (possible when not waiting for ACKs), send it untracked
+   ESP_LOGD(TAG, "No in-flight slot for %s, sent untracked", GateProCmdDefs[entry.cmd].name);
+   // nothing would ever time this RS out, the poller must not wait for its ACK
+   if (entry.cmd == GATEPRO_CMD_READ_STATUS) {
+      this->rs_outstanding = false;
+   }
+   this->release_tx_entry(entry);
+}
+
+// the oldest command waiting for this type of ACK is the one answered
+void GatePro::ack_received(GateProMsgType type) {
+   if (type == GATEPRO_MSG_ACK_RS) {
+      this->rs_outstanding = false;
+   }
+   InFlight *oldest = nullptr;
+   for (auto &in : this->in_flight) {
+      if (in.active && GateProCmdSpecs[in.entry.cmd].ack == type &&
+            (!oldest || (int32_t) (in.sent_at - oldest->sent_at) < 0)) {
+         oldest = &in;
+      }
+   }
+   if (!oldest) {
+      return;
+   }
+
+   const uint32_t rtt = millis() - oldest->sent_at;
+   if (!this->rtt_count || rtt < this->diag_values[GATEPRO_DIAG_RTT_MIN]) {
+      this->diag_values[GATEPRO_DIAG_RTT_MIN] = rtt;
+   }
+   if (rtt > this->diag_values[GATEPRO_DIAG_RTT_MAX]) {
+      this->diag_values[GATEPRO_DIAG_RTT_MAX] = rtt;
+   }
+   this->rtt_count++;
+   this->rtt_sum += rtt;
+   this->diag_values[GATEPRO_DIAG_RTT_AVG] = (float) this->rtt_sum / this->rtt_count;
+
+   oldest->active = false;
+   this->release_tx_entry(oldest->entry);
+}
+
+// the controller evidently acted on cmd (its motor event arrived), a lost ACK mustn't trigger a resend
+void GatePro::confirm_in_flight(GateProCmd cmd) {
+   for (auto &in : this->in_flight) {
+      if (in.active && in.entry.cmd == cmd) {
+         in.active = false;
+         this->release_tx_entry(in.entry);
+      }
+   }
+}
+
+// motion commands only ever make sense as the latest one, older ones are no longer resent
+void GatePro::supersede_in_flight_motion() {
+   for (auto &in : this->in_flight) {
+      if (in.active && GateProCmdSpecs[in.entry.cmd].prio == GATEPRO_TX_PRIO_MOTION) {
+         ESP_LOGD(TAG, "%s superseded, not waiting for its ACK", GateProCmdDefs[in.entry.cmd].name);
+         in.active = false;
+         this->release_tx_entry(in.entry);
+      }
    }
 }
 
+// resends commands whose ACK didn't arrive in time, as many times as their spec allows
+void GatePro::check_in_flight() {
+   const uint32_t now = millis();
+   for (auto &in : this->in_flight) {
+      // a slot never used holds no valid command
+      if (!in.active) {
+         continue;
+      }
+      const GateProCmdSpec &spec = GateProCmdSpecs[in.entry.cmd];
+      if (now - in.sent_at < spec.timeout_ms) {
+         continue;
+      }
+      in.active = false;
+      if (in.entry.attempts < spec.retries) {
+         ESP_LOGD(TAG, "No ACK for %s, resending", GateProCmdDefs[in.entry.cmd].name);
+         in.entry.attempts++;
+         this->diag_values[GATEPRO_DIAG_RETRIES]++;
+         if (!this->tx_queues[spec.prio].push_front(in.entry)) {
+            this->drop_tx_entry(in.entry);
+         }
+         continue;
+      }
+      ESP_LOGW(TAG, "No ACK for %s, giving up", GateProCmdDefs[in.entry.cmd].name);
+      if (in.entry.cmd == GATEPRO_CMD_READ_STATUS) {
+         this->rs_outstanding = false;
+      }
+      this->release_tx_entry(in.entry);
+   }
+}
+
+void GatePro::release_tx_entry(const TxEntry &entry) {
+   if (entry.slot >= 0) {
+      this->tx_pool[entry.slot].used = false;
+   }
+}
+
+bool GatePro::write_uart() {
+   // highest priority class with anything queued
+   GateProFixedQueue<TxEntry, TX_QUEUE_DEPTH> *queue = nullptr;
+   for (auto &q : this->tx_queues) {
+      if (!q.empty()) {
+         queue = &q;
+         break;
+      }
+   }
+   if (!queue) {
+      return false;
+   }
+   const TxEntry entry = queue->front();
+   queue->pop_front();
+
+   const char *data;
+   size_t len;
+   if (entry.slot < 0) {
+      const std::string_view frame = GateProCmds.frame(entry.cmd);
+      data = frame.data();
+      len = frame.size();
+   } else {
+      data = this->tx_pool[entry.slot].data;
+      len = this->tx_pool[entry.slot].len;
+   }
+   if (!len) {
+      return false;
+   }
+
+   this->write_array(reinterpret_cast<const uint8_t *>(data), len);
+   if (GateProCmdSpecs[entry.cmd].prio == GATEPRO_TX_PRIO_MOTION) {
+      this->diag_values[GATEPRO_DIAG_TX_LATENCY] = micros() - entry.queued_at;
+   }
+   this->log_frame("TX", std::string_view(data, len - TX_DELIMITER_LENGTH));
+   this->track_in_flight(entry);
+   return true;
+}
+
 ////////////////////////////////////////////
 // Component functions
 ////////////////////////////////////////////
@@ -432,19 +1491,30 @@ void GatePro::setup() {
    this->startup = true;
    this->queue_gatepro_cmd(GATEPRO_CMD_READ_STATUS);
    this->target_position_ = 0.0f;
+   this->last_rx_at = millis();
+   this->restore_state();
+   this->restore_travel_profile();
+   // cached params are shown meanwhile, the RP goes out first anyway (it's in the higher TX class)
    this->queue_gatepro_cmd(GATEPRO_CMD_READ_PARAMS);
    this->queue_gatepro_cmd(GATEPRO_CMD_DEVINFO);
    this->queue_gatepro_cmd(GATEPRO_CMD_READ_LEARN_STATUS);
 
+   // the hub services this gate, the own loop would only return
+   if (this->hub) {
+      this->disable_loop();
+   }
+
    // set up frontend controllers  
    // Switches
-   for (auto swi : this->switches_with_indices) {
+   for (const auto &swi : this->switches_with_desc) {
+      const GateProSwitchDesc *desc = swi.desc;
       swi.switch_->add_on_state_callback(
-         [this, swi](bool state) {
-            if (this->params[swi.idx] == state) {
+         [this, desc](bool state) {
+            const int value = state ? desc->on_value : desc->off_value;
+            if (desc->idx < this->params_count && this->params[desc->idx] == value) {
                return;
             }
-            this->set_param(swi.idx, state ? 1 : 0);
+            this->set_param(desc->idx, value);
          }
       );
    }
@@ -459,37 +1529,110 @@ void GatePro::setup() {
    }
 
    //selects
-   for (auto swd : this->select_with_data) {
+   for (const auto &swd : this->selects_with_desc) {
+      const GateProSelectDesc *desc = swd.desc;
       swd.select->add_on_state_callback(
-         [this, swd](size_t index) {
-            if (this->params[swd.idx] == swd.values[index]) {
+         [this, desc](size_t index) {
+            if (index >= desc->count) {
                return;
             }
-            this->set_param(swd.idx, swd.values[index]);
+            if (desc->idx < this->params_count && this->params[desc->idx] == desc->values[index]) {
+               return;
+            }
+            this->set_param(desc->idx, desc->values[index]);
          }
       );
    }
 }
 
 void GatePro::update() {
+   // share of the time since the last update the loop spent asleep
+   const uint32_t now = millis();
+   uint32_t slept = this->slept_ms;
+   if (this->sleeping) {
+      slept += now - this->slept_at;
+      this->slept_at = now;
+   }
+   if (now != this->sleep_window_at) {
+      this->diag_values[GATEPRO_DIAG_LOOP_IDLE_RATIO] = roundf(100.0f * slept / (now - this->sleep_window_at));
+   }
+   this->slept_ms = 0;
+   this->sleep_window_at = now;
+   this->diag_values[GATEPRO_DIAG_TIME_SINCE_RX] = (millis() - this->last_rx_at) / 1000;
    this->publish();
-   this->stop_at_target_position();
+   this->publish_diag();
+   this->publish_eta();
 
-   this->write_uart();
+   this->correction_after_operation();
+}
 
-   if (this->current_operation != cover::COVER_OPERATION_IDLE) {
-      this->queue_gatepro_cmd(GATEPRO_CMD_READ_STATUS);
+void GatePro::loop() {
+   // the hub services its gates itself
+   if (this->hub) {
+      return;
    }
+   this->service(this->loop_budget_us);
+}
 
-   this->correction_after_operation();
+void GatePro::service(uint32_t budget_us) {
+   this->commit_params();
+
+   /* Drain every complete frame that's available, so a burst (e.g. ACK FULL OPEN followed
+      by several motor events and an ACK RS) is handled within the same loop. The budget
+      keeps a flood from starving the rest of the main loop, leftovers wait for the next one.
+   */
+   const uint32_t start = micros();
+   while (this->process()) {
+      if (micros() - start >= budget_us) {
+         break;
+      }
+   }
+
+   this->interpolate_position();
+   this->schedule_poll();
+   this->check_link();
+   this->check_in_flight();
+   this->pace_tx();
+
+   // whatever's left in the ring is backlog (a partial frame at minimum, when keeping up)
+   const float backlog = this->rx_ring.size();
+   if (backlog > this->diag_values[GATEPRO_DIAG_RX_BACKLOG]) {
+      this->diag_values[GATEPRO_DIAG_RX_BACKLOG] = backlog;
+   }
+
+   if (this->idle()) {
+      this->sleep();
+   }
 }
 
-void GatePro::loop() {
-   this->process();
+/* The instance itself (rings, queues and pools are all embedded) plus the heap held
+   by the entity lists. The entity callbacks' std::function storage isn't included.
+*/
+size_t GatePro::ram_usage() const {
+   return sizeof(GatePro) +
+          this->switches_with_desc.capacity() * sizeof(SwitchWithDesc) +
+          this->buttons_with_cmds.capacity() * sizeof(ButtonWithCmd) +
+          this->selects_with_desc.capacity() * sizeof(SelectWithDesc);
 }
 
 void GatePro::dump_config(){
    ESP_LOGCONFIG(TAG, "GatePro sensor dump config");
+   ESP_LOGCONFIG(TAG, "  Loop budget: %uus", (unsigned) this->loop_budget_us);
+   ESP_LOGCONFIG(TAG, "  Param write window: %ums", (unsigned) this->param_write_window);
+   ESP_LOGCONFIG(TAG, "  Params max age: %ums", (unsigned) this->params_max_age);
+   ESP_LOGCONFIG(TAG, "  TX min gap: %ums", (unsigned) this->tx_min_gap);
+   ESP_LOGCONFIG(TAG, "  TX waits for ACK: %s", YESNO(this->tx_wait_ack));
+   ESP_LOGCONFIG(TAG, "  Interpolation interval: %ums", (unsigned) this->interpolation_interval);
+   ESP_LOGCONFIG(TAG, "  Link timeout: %ums", (unsigned) this->link_timeout);
+   ESP_LOGCONFIG(TAG, "  Poll intervals: fast %ums, cruise %ums, idle %ums", (unsigned) this->poll_interval_fast,
+                 (unsigned) this->poll_interval_cruise, (unsigned) this->poll_interval_idle);
+   ESP_LOGCONFIG(TAG, "  Sleeps while idle: %s", YESNO(this->idle_sleep));
+   ESP_LOGCONFIG(TAG, "  Running on a hub: %s", YESNO(this->hub));
+   ESP_LOGCONFIG(TAG, "  Instance RAM: %u bytes", (unsigned) this->ram_usage());
+   ESP_LOGCONFIG(TAG, "    RX ring: %u, TX queues: %u, TX pool: %u, in flight: %u, param txns: %u, entities: %u",
+                 (unsigned) sizeof(this->rx_ring), (unsigned) sizeof(this->tx_queues), (unsigned) sizeof(this->tx_pool),
+                 (unsigned) sizeof(this->in_flight), (unsigned) sizeof(this->param_txns),
+                 (unsigned) (this->ram_usage() - sizeof(GatePro)));
 }
 
 }  // namespace gatepro
@@ -1,20 +1,24 @@
 #pragma once
 
-#include <map>
+#include <array>
 #include <vector>
-#include <queue>
-#include <functional>
+#include <string_view>
 #include "esphome.h"
 #include "esphome/core/component.h"
 #include "esphome/components/uart/uart.h"
 #include "esphome/components/cover/cover.h"
 #include "esphome/components/sensor/sensor.h"
+#include "esphome/components/binary_sensor/binary_sensor.h"
 #include "esphome/components/text_sensor/text_sensor.h"
 #include "esphome/components/button/button.h"
 //#include "esphome/components/number/number.h"
 #include "esphome/components/switch/switch.h"
 #include "esphome/components/select/select.h"
 #include "constants.h"
+#include "gatepro_parse.h"
+#include "gatepro_rx_ring.h"
+#include "gatepro_tx_queue.h"
+#include "gatepro_hub.h"
 
 namespace esphome {
 namespace gatepro {
@@ -23,15 +27,45 @@ class GatePro : public cover::Cover, public PollingComponent, public uart::UARTD
    public:
       void set_txt_devinfo(esphome::text_sensor::TextSensor *txt) { txt_devinfo = txt; }
       void set_txt_learn_status(esphome::text_sensor::TextSensor *txt) { txt_learn_status = txt; }
-      void set_switch(u_int param_idx, switch_::Switch *switch_) {
-         this->switches_with_indices.push_back(SwitchWithIdx(param_idx, switch_));
+      void set_txt_status_raw(esphome::text_sensor::TextSensor *txt) { txt_status_raw = txt; }
+      void set_moving_binary_sensor(binary_sensor::BinarySensor *sens) { this->moving_binary_sensor = sens; }
+      void set_opening_binary_sensor(binary_sensor::BinarySensor *sens) { this->opening_binary_sensor = sens; }
+      void set_status_position_sensor(sensor::Sensor *sens) { this->status_position_sensor = sens; }
+      void set_time_to_open_sensor(sensor::Sensor *sens) { this->time_to_open_sensor = sens; }
+      void set_time_to_close_sensor(sensor::Sensor *sens) { this->time_to_close_sensor = sens; }
+      void set_switch(switch_::Switch *switch_, const GateProSwitchDesc *desc) {
+         this->switches_with_desc.push_back(SwitchWithDesc{switch_, desc});
       }
-      void set_button(button::Button *button, std::string command_name) {
-         this->buttons_with_cmds.push_back(ButtonWithCmd(button, GateProUIBtnMapping.at(command_name)));
+      void set_button(button::Button *button, GateProCmd cmd) {
+         this->buttons_with_cmds.push_back(ButtonWithCmd(button, cmd));
       }
-      void set_select(select::Select *sel, int idx, std::vector<std::string> options, std::vector<int> values) {
-         select_with_data.push_back(SelectWithIdxOpts(sel, idx, options, values));
+      void set_select(select::Select *sel, const GateProSelectDesc *desc) {
+         this->selects_with_desc.push_back(SelectWithDesc{sel, desc});
       }
+      void set_loop_budget(uint32_t budget_us) { this->loop_budget_us = budget_us; }
+      void set_param_write_window(uint32_t window) { this->param_write_window = window; }
+      void set_params_max_age(uint32_t max_age) { this->params_max_age = max_age; }
+      void set_tx_min_gap(uint32_t gap) { this->tx_min_gap = gap; }
+      void set_tx_wait_ack(bool wait_ack) { this->tx_wait_ack = wait_ack; }
+      void set_poll_intervals(uint32_t fast, uint32_t cruise, uint32_t idle) {
+         this->poll_interval_fast = fast;
+         this->poll_interval_cruise = cruise;
+         this->poll_interval_idle = idle;
+      }
+      void set_interpolation_interval(uint32_t interval) { this->interpolation_interval = interval; }
+      void set_link_timeout(uint32_t timeout) { this->link_timeout = timeout; }
+      void set_idle_sleep(bool idle_sleep) { this->idle_sleep = idle_sleep; }
+      void set_diag_sensor(sensor::Sensor *sens, GateProDiag diag) { this->diag_sensors[diag] = sens; }
+      void set_hub(GateProHub *hub) { this->hub = hub; }
+
+      // one round of RX / TX work, called from loop() or, when running on a hub, by the hub
+      void service(uint32_t budget_us);
+      bool in_motion() const { return this->current_operation != cover::COVER_OPERATION_IDLE; }
+      size_t ram_usage() const;
+      // idle mode
+      bool is_sleeping() const { return this->sleeping; }
+      bool wake_due();
+      void wake();
 
       void setup() override;
       void update() override;
@@ -41,12 +75,14 @@ class GatePro : public cover::Cover, public PollingComponent, public uart::UARTD
 
    protected:
       // helpers
-      std::string current_msg;
+      // view into the RX ring, valid until the next read_uart()
+      std::string_view current_msg;
       bool read_msg();
-      GateProMsgType identify_current_msg_type(std::map<GateProMsgType, const GateProMsgConstant>);
-      int get_position_percentage();
-      bool is_moving();
-      std::string convert(uint8_t*, size_t);
+      GateProMsgType identify_current_msg_type();
+      GateProMsgType identify_motor_event();
+      bool parse_status(GateProStatus &status);
+      void publish_status(const GateProStatus &status);
+      void log_frame(const char *dir, std::string_view frame);
 
       // device logic
       int after_tick = AFTER_TICK_MAX;
@@ -60,29 +96,162 @@ class GatePro : public cover::Cover, public PollingComponent, public uart::UARTD
       void control(const cover::CoverCall &call) override;
       void start_direction_(cover::CoverOperation dir);
       void stop_at_target_position();
+      // latency compensated stopping & its statistics
+      uint32_t stop_queued_at = 0;
+      float stop_latency_ms = STOP_LATENCY_MS;
+      float stop_target = 0.0f;
+      bool stop_opening = false;
+      bool overshoot_pending = false;
+      uint32_t overshoot_count = 0;
+      float overshoot_abs_sum = 0;
+      void stop_finished();
+      void record_overshoot();
+      // status poller
+      bool rs_outstanding = false;
+      bool poll_status();
+      void cancel_status_polls();
+      // poll rate policy
+      uint32_t poll_interval_fast = POLL_INTERVAL_FAST_MS;
+      uint32_t poll_interval_cruise = POLL_INTERVAL_CRUISE_MS;
+      uint32_t poll_interval_idle = POLL_INTERVAL_IDLE_MS;
+      uint32_t last_poll_at = 0;
+      uint32_t operation_polls = 0;
+      size_t param_option(size_t idx, size_t count);
+      float param_fraction(size_t idx, const float *fractions, size_t count, float fallback);
+      uint32_t poll_interval();
+      void schedule_poll();
+      bool scheduled_poll();
+      // link watchdog
+      uint32_t link_timeout = LINK_TIMEOUT_MS;
+      uint32_t last_rx_at = 0;
+      bool link_up = true;
+      void check_link();
+      // idle mode: no loop work while there's nothing to send, receive or wait for
+      bool idle_sleep = true;
+      bool sleeping = false;
+      uint32_t wake_at = 0;
+      uint32_t slept_at = 0;
+      uint32_t slept_ms = 0;
+      uint32_t sleep_window_at = 0;
+      bool idle();
+      void sleep();
+      void link_received();
+      void flush_tx();
+
+      // motion model, speeds in travel fraction / s, per direction (open, close) and speed setting
+      float learned_speeds[2][SPEED_SETTINGS]{};
+      float anchor_position = 0;
+      uint32_t anchor_at = 0;
+      bool anchored = false;
+      float op_start_position = 0;
+      uint32_t op_start_at = 0;
+      uint32_t interpolation_interval = INTERPOLATION_INTERVAL_MS;
+      uint32_t last_interpolation_at = 0;
+      size_t speed_setting();
+      float &learned_speed();
+      float current_speed();
+      void learn_speed(float speed);
+      void motion_started();
+      void motion_sample();
+      void motion_finished();
+      void interpolate_position();
+
+      // travel time profile & ETAs
+      ESPPreferenceObject travel_pref;
+      GateProTravelProfile travel{};
+      sensor::Sensor *time_to_open_sensor{nullptr};
+      sensor::Sensor *time_to_close_sensor{nullptr};
+      void restore_travel_profile();
+      void learn_travel_time(uint32_t duration, float travelled);
+      void publish_eta();
       void correction_after_operation();
-      void process();
+      bool process();
+      void handle_msg();
+      // max time spent draining RX frames per loop()
+      uint32_t loop_budget_us = LOOP_BUDGET_US;
 
       // param logic
-      std::vector<int> params;
-      std::string params_cmd;
-      bool param_no_pub = false;
-      std::queue<std::function<void()>> paramTaskQueue;
+      std::array<int, PARAMS_MAX> params{};
+      size_t params_count = 0;
+      // params as last published to the entities, bit i of the mask: index i was published
+      std::array<int, PARAMS_MAX> published_params{};
+      uint32_t published_mask = 0;
       void publish_params();
-      void write_params();
-      void parse_params();
+      bool write_params();
+      bool parse_params();
       void set_param(int idx, int val);
+      // param edits, written in read-modify-write transactions
+      GateProParamTxn param_txns[PARAM_TXN_MAX]{};
+      uint32_t param_write_window = PARAM_WRITE_WINDOW_MS;
+      // cached params younger than this are modified without reading them first
+      uint32_t params_read_at = 0;
+      uint32_t params_max_age = PARAMS_MAX_AGE_MS;
+      uint32_t params_in(GateProParamTxnState state);
+      void commit_params();
+      void apply_pending_params();
+      void params_written();
+      void fail_params(GateProParamTxnState state);
+
+      // persistence
+      ESPPreferenceObject pref;
+      GateProPersistedState persisted{};
+      void restore_state();
+      void save_state();
+      void update_text_info(text_sensor::TextSensor *txt, char *cache, std::string_view info);
 
 
       // sensor logic
       void publish();
+      sensor::Sensor *diag_sensors[GATEPRO_DIAG_COUNT]{};
+      float diag_values[GATEPRO_DIAG_COUNT]{};
+      void publish_diag();
 
       // UART
-      std::string msg_buff;
-      std::queue<const char*> tx_queue;
-      std::queue<std::string> rx_queue;
+      GateProRxRing<RX_RING_SIZE> rx_ring;
+      GateProHub *hub{nullptr};
+      // owned buffers of dynamically built frames, never reallocated
+      struct TxFrame {
+         bool used{false};
+         uint8_t len{0};
+         char data[TX_FRAME_SIZE];
+      };
+      TxFrame tx_pool[TX_POOL_SIZE];
+      int8_t acquire_tx_frame();
+      // queued frame: a static command or a pool slot (-1 for static)
+      struct TxEntry {
+         GateProCmd cmd;
+         int8_t slot;
+         uint32_t queued_at;
+         uint8_t attempts;
+      };
+      // one bounded FIFO per priority class
+      GateProFixedQueue<TxEntry, TX_QUEUE_DEPTH> tx_queues[GATEPRO_TX_PRIO_COUNT];
+      bool queue_tx(GateProCmd cmd, int8_t slot);
+      void drop_tx_entry(const TxEntry &entry);
       void read_uart();
-      void write_uart();
+      bool write_uart();
+      // TX is paced from loop(), independently of the polling cadence
+      uint32_t tx_min_gap = TX_MIN_GAP_MS;
+      bool tx_wait_ack = false;
+      uint32_t last_tx_at = 0;
+      void pace_tx();
+
+      // commands sent and awaiting their ACK
+      struct InFlight {
+         bool active{false};
+         TxEntry entry{};
+         uint32_t sent_at{0};
+      };
+      InFlight in_flight[IN_FLIGHT_MAX];
+      uint32_t rtt_count = 0;
+      uint32_t rtt_sum = 0;
+      size_t in_flight_count();
+      void track_in_flight(const TxEntry &entry);
+      void ack_received(GateProMsgType type);
+      void check_in_flight();
+      void confirm_in_flight(GateProCmd cmd);
+      void supersede_in_flight_motion();
+      void release_tx_entry(const TxEntry &entry);
 
       // UI
       esphome::button::Button *btn_learn;
@@ -91,12 +260,15 @@ class GatePro : public cover::Cover, public PollingComponent, public uart::UARTD
       esphome::button::Button *btn_read_status;
       text_sensor::TextSensor *txt_devinfo{nullptr};
       text_sensor::TextSensor *txt_learn_status{nullptr};
-      struct SwitchWithIdx {
-         u_int idx;
+      text_sensor::TextSensor *txt_status_raw{nullptr};
+      binary_sensor::BinarySensor *moving_binary_sensor{nullptr};
+      binary_sensor::BinarySensor *opening_binary_sensor{nullptr};
+      sensor::Sensor *status_position_sensor{nullptr};
+      struct SwitchWithDesc {
          switch_::Switch *switch_;
-         SwitchWithIdx(u_int idx, switch_::Switch *switch_) : idx(idx), switch_(switch_) {};
+         const GateProSwitchDesc *desc;
       };
-      std::vector<SwitchWithIdx> switches_with_indices;
+      std::vector<SwitchWithDesc> switches_with_desc;
 
       struct ButtonWithCmd {
          button::Button *button;
@@ -105,15 +277,11 @@ class GatePro : public cover::Cover, public PollingComponent, public uart::UARTD
       };
       std::vector<ButtonWithCmd> buttons_with_cmds;
 
-      struct SelectWithIdxOpts {
+      struct SelectWithDesc {
          select::Select *select;
-         u_int idx;
-         std::vector<std::string> options;
-         std::vector<int> values;
-         SelectWithIdxOpts(select::Select *select, u_int idx, std::vector<std::string> options, std::vector<int> values) :
-                           select(select), idx(idx), options(options), values(values) {};
+         const GateProSelectDesc *desc;
       };
-      std::vector<SelectWithIdxOpts> select_with_data;
+      std::vector<SelectWithDesc> selects_with_desc;
 };
 
 }  // namespace gatepro
@@ -0,0 +1,100 @@
+#include "esphome/core/log.h"
+#include "gatepro_hub.h"
+#include "gatepro.h"
+
+namespace esphome {
+namespace gatepro {
+
+static const char* TAG = "gatepro.hub";
+
+void GateProHub::register_gate(GatePro *gate) {
+   if (this->gate_count == HUB_GATES_MAX) {
+      ESP_LOGE(TAG, "A hub runs at most %u gates, ignoring this one", (unsigned) HUB_GATES_MAX);
+      return;
+   }
+   this->gates[this->gate_count++] = gate;
+   gate->set_hub(this);
+}
+
+bool GateProHub::request_poll(GatePro *gate) {
+   const uint32_t now = millis();
+   if (this->last_poll_at && now - this->last_poll_at < this->poll_spacing) {
+      return false;
+   }
+   if (!gate->in_motion()) {
+      for (size_t i = 0; i < this->gate_count; i++) {
+         if (this->gates[i] != gate && this->gates[i]->in_motion()) {
+            return false;
+         }
+      }
+   }
+   this->last_poll_at = now;
+   return true;
+}
+
+void GateProHub::loop() {
+   if (!this->gate_count) {
+      return;
+   }
+   const uint32_t start = micros();
+   for (size_t n = 0; n < this->gate_count; n++) {
+      // whatever the previous gates left unused is split among the rest
+      const uint32_t spent = micros() - start;
+      const uint32_t left = spent < this->loop_budget_us ? this->loop_budget_us - spent : 0;
+      GatePro *gate = this->gates[(this->next_gate + n) % this->gate_count];
+      if (gate->is_sleeping()) {
+         if (!gate->wake_due()) {
+            continue;
+         }
+         gate->wake();
+      }
+      gate->service(left / (this->gate_count - n));
+   }
+   this->next_gate = (this->next_gate + 1) % this->gate_count;
+
+   for (size_t i = 0; i < this->gate_count; i++) {
+      if (!this->gates[i]->is_sleeping()) {
+         return;
+      }
+   }
+   this->sleep();
+}
+
+void GateProHub::sleep() {
+   this->sleeping = true;
+   this->disable_loop();
+   this->set_interval("idle_wake", IDLE_WAKE_CHECK_MS, [this]() {
+      for (size_t i = 0; i < this->gate_count; i++) {
+         // a gate waking up wakes the hub too
+         if (this->gates[i]->wake_due()) {
+            this->gates[i]->wake();
+         }
+      }
+   });
+}
+
+void GateProHub::wake() {
+   if (!this->sleeping) {
+      return;
+   }
+   this->sleeping = false;
+   this->cancel_interval("idle_wake");
+   this->enable_loop();
+}
+
+void GateProHub::dump_config() {
+   ESP_LOGCONFIG(TAG, "GatePro hub dump config");
+   ESP_LOGCONFIG(TAG, "  Gates: %u", (unsigned) this->gate_count);
+   ESP_LOGCONFIG(TAG, "  Loop budget: %uus", (unsigned) this->loop_budget_us);
+   ESP_LOGCONFIG(TAG, "  Poll spacing: %ums", (unsigned) this->poll_spacing);
+   size_t total = sizeof(GateProHub);
+   for (size_t i = 0; i < this->gate_count; i++) {
+      ESP_LOGCONFIG(TAG, "  Gate %u: %s, %u bytes of RAM", (unsigned) i, this->gates[i]->get_name().c_str(),
+                    (unsigned) this->gates[i]->ram_usage());
+      total += this->gates[i]->ram_usage();
+   }
+   ESP_LOGCONFIG(TAG, "  RAM, hub and gates: %u bytes", (unsigned) total);
+}
+
+}  // namespace gatepro
+}  // namespace esphome
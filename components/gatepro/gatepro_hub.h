@@ -0,0 +1,45 @@
+#pragma once
+
+#include "esphome/core/component.h"
+#include "constants.h"
+
+namespace esphome {
+namespace gatepro {
+
+class GatePro;
+
+/* Runs several gates, each on its own UART, from a single loop:
+   * the gates are serviced round robin, starting with a different one every loop,
+     and share the loop budget, so a flood on one bus can't starve the others
+   * status polls of all the gates go through a shared scheduler, spacing them out;
+     idle polls wait while another gate is moving, motion polls never wait for idle ones
+   * once all the gates sleep, so does the hub: its loop is disabled and a light check
+     wakes it, just like a standalone gate
+*/
+class GateProHub : public Component {
+   public:
+      void register_gate(GatePro *gate);
+      void set_loop_budget(uint32_t budget_us) { this->loop_budget_us = budget_us; }
+      void set_poll_spacing(uint32_t spacing) { this->poll_spacing = spacing; }
+      // asked by a gate about to poll its status, true if it may go ahead
+      bool request_poll(GatePro *gate);
+      // a gate woke up, the hub has to service it again
+      void wake();
+
+      void loop() override;
+      void dump_config() override;
+      float get_setup_priority() const override { return setup_priority::DATA; }
+
+   protected:
+      GatePro *gates[HUB_GATES_MAX]{};
+      size_t gate_count = 0;
+      size_t next_gate = 0;
+      uint32_t loop_budget_us = HUB_LOOP_BUDGET_US;
+      uint32_t poll_spacing = HUB_POLL_SPACING_MS;
+      uint32_t last_poll_at = 0;
+      bool sleeping = false;
+      void sleep();
+};
+
+}  // namespace gatepro
+}  // namespace esphome
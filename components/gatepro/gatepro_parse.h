@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <charconv>
+#include <string_view>
+#include "constants.h"
+
+namespace esphome {
+namespace gatepro {
+
+/* Frame payload parsers, free of any component state so they can be tested on the host.
+   They only accept well-formed frames, anything else is left to the caller to report.
+*/
+
+/* Decodes the hex bytes of an RS frame in a single pass, in place. Controllers
+   reporting fewer bytes are fine, as long as the known fields are there
+   (up to a valid percentage).
+*/
+inline bool parse_status_frame(std::string_view msg, GateProStatus &status) {
+   const size_t start = msg.find(STATUS_START);
+   if (start == std::string_view::npos) {
+      return false;
+   }
+   const char *pos = msg.data() + start + 1;
+   const char *end = msg.data() + msg.size();
+
+   status.count = 0;
+   while (status.count < STATUS_BYTES && end - pos >= 2) {
+      auto [next, ec] = std::from_chars(pos, pos + 2, status.bytes[status.count], 16);
+      if (ec != std::errc() || next != pos + 2) {
+         return false;
+      }
+      status.count++;
+      pos = next;
+      if (pos == end || *pos != STATUS_SEPARATOR) {
+         break;
+      }
+      pos++;
+   }
+   return status.count > STATUS_IDX_PERCENTAGE && status.valid();
+}
+
+/* Reads the decimal values of an RP frame into params, returns how many there were:
+   0 if malformed, or if there are more than PARAMS_MAX.
+*/
+inline size_t parse_params_frame(std::string_view msg, std::array<int, PARAMS_MAX> &params) {
+   const size_t start = msg.find(PARAMS_START);
+   if (start == std::string_view::npos) {
+      return 0;
+   }
+   const char *pos = msg.data() + start + 1;
+   const char *end = msg.data() + msg.size();
+
+   size_t count = 0;
+   while (true) {
+      if (count == PARAMS_MAX) {
+         return 0;
+      }
+      auto [next, ec] = std::from_chars(pos, end, params[count]);
+      if (ec != std::errc()) {
+         return 0;
+      }
+      count++;
+      if (next == end) {
+         return count;
+      }
+      if (*next != PARAMS_SEPARATOR) {
+         return 0;
+      }
+      pos = next + 1;
+   }
+}
+
+}  // namespace gatepro
+}  // namespace esphome
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace esphome {
+namespace gatepro {
+
+template<typename T> struct GateProPattern {
+   T value;
+   const char *match;
+};
+
+constexpr size_t pattern_length(const char *s) {
+   size_t len = 0;
+   while (s[len]) {
+      len++;
+   }
+   return len;
+}
+
+// upper bound of the trie nodes needed for a pattern table (+1 for the root)
+template<typename T, size_t P> constexpr size_t trie_nodes(const GateProPattern<T> (&patterns)[P]) {
+   size_t nodes = 1;
+   for (size_t i = 0; i < P; i++) {
+      nodes += pattern_length(patterns[i].match);
+   }
+   return nodes;
+}
+
+/* Prefix trie built at compile time from a pattern table, lives in flash.
+   match() walks the message once, char by char, and returns the value of the
+   first pattern that's a prefix of it (or `none`). Children are kept as
+   sibling lists, as the tables only branch a handful of times.
+*/
+template<typename T, size_t N> class GateProPrefixTrie {
+   public:
+      template<size_t P> constexpr GateProPrefixTrie(const GateProPattern<T> (&patterns)[P], T none) : none_(none) {
+         this->nodes_[0].value = none;
+         for (size_t i = 0; i < P; i++) {
+            this->insert_(patterns[i].match, patterns[i].value);
+         }
+      }
+
+      constexpr T match(std::string_view msg) const {
+         uint8_t node = 0;
+         for (const char c : msg) {
+            node = this->child_(node, c);
+            if (!node) {
+               return this->none_;
+            }
+            if (this->nodes_[node].value != this->none_) {
+               return this->nodes_[node].value;
+            }
+         }
+         return this->none_;
+      }
+
+   protected:
+      static_assert(N <= 256, "trie node indices are 8 bit");
+      // index 0 is the root, so it doubles as "no child / no sibling"
+      struct Node {
+         char ch{0};
+         T value{};
+         uint8_t child{0};
+         uint8_t sibling{0};
+      };
+
+      constexpr uint8_t child_(uint8_t node, char c) const {
+         for (uint8_t i = this->nodes_[node].child; i; i = this->nodes_[i].sibling) {
+            if (this->nodes_[i].ch == c) {
+               return i;
+            }
+         }
+         return 0;
+      }
+
+      constexpr void insert_(const char *match, T value) {
+         uint8_t node = 0;
+         for (size_t i = 0; match[i]; i++) {
+            uint8_t next = this->child_(node, match[i]);
+            if (!next) {
+               next = this->used_++;
+               this->nodes_[next].ch = match[i];
+               this->nodes_[next].value = this->none_;
+               this->nodes_[next].sibling = this->nodes_[node].child;
+               this->nodes_[node].child = next;
+            }
+            node = next;
+         }
+         this->nodes_[node].value = value;
+      }
+
+      Node nodes_[N]{};
+      size_t used_{1};
+      T none_;
+};
+
+}  // namespace gatepro
+}  // namespace esphome
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+namespace esphome {
+namespace gatepro {
+
+/* Fixed-capacity RX byte ring with an in-place CRLF frame scanner.
+   * UART bytes are read straight into the ring (see write_ptr() / commit()),
+     no intermediate buffers are allocated
+   * complete frames are handed out as non-owning views, without the CRLF
+   * a frame wrapping around the end of the ring is linearized into a scratch
+     buffer, so a view is always contiguous
+   * a view stays valid until the next write into the ring
+*/
+template<size_t N> class GateProRxRing {
+   public:
+      size_t size() const { return this->count_; }
+      size_t capacity() const { return N; }
+      bool full() const { return this->count_ == N; }
+      // full, and already scanned without finding a delimiter
+      bool exhausted() const { return this->full() && this->scanned_ + 1 >= this->count_; }
+      void clear() {
+         this->head_ = 0;
+         this->count_ = 0;
+         this->scanned_ = 0;
+      }
+
+      // contiguous free space at the write position
+      uint8_t *write_ptr(size_t &room) {
+         const size_t tail = (this->head_ + this->count_) % N;
+         room = std::min(N - this->count_, N - tail);
+         return &this->buf_[tail];
+      }
+      void commit(size_t len) { this->count_ += len; }
+
+      // pops the next complete frame, if any
+      bool next_frame(std::string_view &frame) {
+         // resume where the previous scan stopped, so every byte is only looked at once
+         for (; this->scanned_ + 1 < this->count_; this->scanned_++) {
+            if (this->at_(this->scanned_) != '\r' || this->at_(this->scanned_ + 1) != '\n') {
+               continue;
+            }
+            const size_t len = this->scanned_;
+            frame = this->view_(len);
+            this->head_ = (this->head_ + len + 2) % N;
+            this->count_ -= len + 2;
+            this->scanned_ = 0;
+            return true;
+         }
+         return false;
+      }
+
+   protected:
+      uint8_t at_(size_t i) const { return this->buf_[(this->head_ + i) % N]; }
+
+      std::string_view view_(size_t len) {
+         if (this->head_ + len <= N) {
+            return std::string_view(reinterpret_cast<const char *>(&this->buf_[this->head_]), len);
+         }
+         const size_t first = N - this->head_;
+         memcpy(this->scratch_, &this->buf_[this->head_], first);
+         memcpy(this->scratch_ + first, this->buf_, len - first);
+         return std::string_view(this->scratch_, len);
+      }
+
+      uint8_t buf_[N];
+      char scratch_[N];
+      size_t head_{0};
+      size_t count_{0};
+      size_t scanned_{0};
+};
+
+}  // namespace gatepro
+}  // namespace esphome
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+
+namespace esphome {
+namespace gatepro {
+
+/* Fixed-capacity FIFO on a ring, no heap use. Pushing into a full queue fails,
+   the caller decides what (if anything) to drop to make room.
+*/
+template<typename T, size_t N> class GateProFixedQueue {
+   public:
+      size_t size() const { return this->count_; }
+      size_t capacity() const { return N; }
+      bool empty() const { return this->count_ == 0; }
+      bool full() const { return this->count_ == N; }
+      void clear() {
+         this->head_ = 0;
+         this->count_ = 0;
+      }
+
+      // i-th entry from the front
+      T &operator[](size_t i) { return this->buf_[(this->head_ + i) % N]; }
+      const T &operator[](size_t i) const { return this->buf_[(this->head_ + i) % N]; }
+      T &front() { return this->buf_[this->head_]; }
+
+      bool push_back(const T &item) {
+         if (this->full()) {
+            return false;
+         }
+         this->buf_[(this->head_ + this->count_) % N] = item;
+         this->count_++;
+         return true;
+      }
+      bool push_front(const T &item) {
+         if (this->full()) {
+            return false;
+         }
+         this->head_ = (this->head_ + N - 1) % N;
+         this->buf_[this->head_] = item;
+         this->count_++;
+         return true;
+      }
+      void pop_front() {
+         this->head_ = (this->head_ + 1) % N;
+         this->count_--;
+      }
+
+      // removes the matching entries, keeping the order of the rest
+      template<typename Pred> size_t remove_if(Pred pred) {
+         size_t kept = 0;
+         for (size_t i = 0; i < this->count_; i++) {
+            T &item = (*this)[i];
+            if (pred(item)) {
+               continue;
+            }
+            if (kept != i) {
+               (*this)[kept] = item;
+            }
+            kept++;
+         }
+         const size_t removed = this->count_ - kept;
+         this->count_ = kept;
+         return removed;
+      }
+
+   protected:
+      T buf_[N];
+      size_t head_{0};
+      size_t count_{0};
+};
+
+}  // namespace gatepro
+}  // namespace esphome
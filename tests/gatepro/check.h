@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdio>
+
+// minimal assertions, so the host tests need nothing beyond the standard library
+static int check_failures = 0;
+
+#define CHECK(cond) \
+   do { \
+      if (!(cond)) { \
+         std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+         check_failures++; \
+      } \
+   } while (0)
+#define CHECK_EQ(a, b) CHECK((a) == (b))
+
+inline int check_result(const char *name) {
+   if (check_failures) {
+      std::fprintf(stderr, "%s: %d check(s) failed\n", name, check_failures);
+      return 1;
+   }
+   std::printf("%s: ok\n", name);
+   return 0;
+}
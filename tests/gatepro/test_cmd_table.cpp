@@ -0,0 +1,38 @@
+#include <string>
+#include "check.h"
+#include "constants.h"
+
+using namespace esphome::gatepro;
+
+static void test_frames() {
+   for (size_t i = 0; i < GATEPRO_CMD_COUNT; i++) {
+      const GateProCmd cmd = static_cast<GateProCmd>(i);
+      const GateProCmdDef &def = GateProCmdDefs[cmd];
+      std::string expected = def.name;
+      if (def.with_source) {
+         expected += ";src=" GATEPRO_SOURCE_ID;
+      }
+      CHECK_EQ(GateProCmds.text(cmd), expected);
+      CHECK_EQ(GateProCmds.frame(cmd), expected + "\r\n");
+      // frames follow each other in the arena
+      if (i) {
+         const std::string_view prev = GateProCmds.frame(static_cast<GateProCmd>(i - 1));
+         CHECK_EQ(prev.data() + prev.size(), GateProCmds.frame(cmd).data());
+      }
+   }
+}
+
+static void test_known_frames() {
+   CHECK_EQ(GateProCmds.frame(GATEPRO_CMD_NONE), "NAK\r\n");
+   CHECK_EQ(GateProCmds.frame(GATEPRO_CMD_OPEN), "FULL OPEN;src=" GATEPRO_SOURCE_ID "\r\n");
+   CHECK_EQ(GateProCmds.frame(GATEPRO_CMD_READ_STATUS), "RS;src=" GATEPRO_SOURCE_ID "\r\n");
+   CHECK_EQ(GateProCmds.frame(GATEPRO_CMD_READ_PARAMS), "RP,1:;src=" GATEPRO_SOURCE_ID "\r\n");
+   // continued with the values by write_params()
+   CHECK_EQ(GateProCmds.text(GATEPRO_CMD_WRITE_PARAMS), "WP,1:");
+}
+
+int main() {
+   test_frames();
+   test_known_frames();
+   return check_result("test_cmd_table");
+}
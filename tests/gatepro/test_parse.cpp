@@ -0,0 +1,105 @@
+#include <string>
+#include "check.h"
+#include "gatepro_parse.h"
+
+using namespace esphome::gatepro;
+
+static void test_status() {
+   GateProStatus status;
+   CHECK(parse_status_frame("ACK RS:00,80,C4,C6,3E,16,FF,FF,FF", status));
+   CHECK_EQ(status.count, STATUS_BYTES);
+   CHECK(status.moving());
+   CHECK(status.opening());
+   CHECK_EQ(status.percentage(), 70);
+
+   // fewer bytes are fine, as long as the percentage is there
+   CHECK(parse_status_frame("ACK RS:00,80,00,64", status));
+   CHECK_EQ(status.count, 4);
+   CHECK(!status.moving());
+   CHECK(!status.opening());
+   CHECK_EQ(status.percentage(), 100);
+
+   // bytes beyond the known ones are ignored
+   CHECK(parse_status_frame("ACK RS:00,80,C4,E4,3E,16,FF,FF,FF,AA,BB", status));
+   CHECK_EQ(status.count, STATUS_BYTES);
+   CHECK_EQ(status.percentage(), 100);
+}
+
+static void test_malformed_status() {
+   GateProStatus status;
+   CHECK(!parse_status_frame("", status));
+   CHECK(!parse_status_frame("ACK RS", status));
+   CHECK(!parse_status_frame("ACK RS:", status));
+   // no percentage
+   CHECK(!parse_status_frame("ACK RS:00,80,C4", status));
+   CHECK(!parse_status_frame("ACK RS:00,80,C4,", status));
+   CHECK(!parse_status_frame("ACK RS:00,80,C4,6", status));
+   // not hex, or not two digits
+   CHECK(!parse_status_frame("ACK RS:00,8G,C4,C6", status));
+   CHECK(!parse_status_frame("ACK RS:0,80,C4,C6", status));
+   CHECK(!parse_status_frame("ACK RS:00,80,-1,C6", status));
+   // broken separator, the percentage is never reached
+   CHECK(!parse_status_frame("ACK RS:00;80,C4,C6", status));
+   // out of range: neither 0..100 nor 128..228
+   CHECK(!parse_status_frame("ACK RS:00,80,C4,65", status));
+   CHECK(!parse_status_frame("ACK RS:00,80,C4,7F", status));
+   CHECK(!parse_status_frame("ACK RS:00,80,C4,E5", status));
+   CHECK(!parse_status_frame("ACK RS:00,80,C4,FF", status));
+   CHECK(parse_status_frame("ACK RS:00,80,C4,80", status));
+   CHECK_EQ(status.percentage(), 0);
+}
+
+// "ACK RP,1:" followed by n params
+static std::string params_frame(size_t n) {
+   std::string frame = "ACK RP,1:";
+   for (size_t i = 0; i < n; i++) {
+      frame += (i ? "," : "") + std::to_string(i);
+   }
+   return frame;
+}
+
+static void test_params() {
+   std::array<int, PARAMS_MAX> params{};
+   CHECK_EQ(parse_params_frame("ACK RP,1:1,0,0,1,2,2,0,0,0,3,0,0,3,0,0,0,0", params), 17u);
+   CHECK_EQ(params[0], 1);
+   CHECK_EQ(params[3], 1);
+   CHECK_EQ(params[12], 3);
+   CHECK_EQ(params[16], 0);
+
+   CHECK_EQ(parse_params_frame("ACK RP,1:7", params), 1u);
+   CHECK_EQ(params[0], 7);
+   CHECK_EQ(parse_params_frame("ACK RP,1:12,-1", params), 2u);
+   CHECK_EQ(params[0], 12);
+   CHECK_EQ(params[1], -1);
+
+   CHECK_EQ(parse_params_frame(params_frame(PARAMS_MAX), params), PARAMS_MAX);
+   CHECK_EQ(params[PARAMS_MAX - 1], (int) PARAMS_MAX - 1);
+}
+
+static void test_malformed_params() {
+   std::array<int, PARAMS_MAX> params{};
+   CHECK_EQ(parse_params_frame("", params), 0u);
+   CHECK_EQ(parse_params_frame("ACK RP,1", params), 0u);
+   CHECK_EQ(parse_params_frame("ACK RP,1:", params), 0u);
+   // empty values
+   CHECK_EQ(parse_params_frame("ACK RP,1:1,2,", params), 0u);
+   CHECK_EQ(parse_params_frame("ACK RP,1:1,,2", params), 0u);
+   CHECK_EQ(parse_params_frame("ACK RP,1:,1", params), 0u);
+   // not decimal, or not separated by commas
+   CHECK_EQ(parse_params_frame("ACK RP,1:1,a", params), 0u);
+   CHECK_EQ(parse_params_frame("ACK RP,1:1,2x", params), 0u);
+   CHECK_EQ(parse_params_frame("ACK RP,1:1;2", params), 0u);
+   CHECK_EQ(parse_params_frame("ACK RP,1:1, 2", params), 0u);
+   // doesn't fit an int
+   CHECK_EQ(parse_params_frame("ACK RP,1:1,99999999999", params), 0u);
+   // more params than there's room for
+   CHECK_EQ(parse_params_frame(params_frame(PARAMS_MAX + 1), params), 0u);
+}
+
+int main() {
+   test_status();
+   test_malformed_status();
+   test_params();
+   test_malformed_params();
+   return check_result("test_parse");
+}
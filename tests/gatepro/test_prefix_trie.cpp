@@ -0,0 +1,66 @@
+#include "check.h"
+#include "constants.h"
+
+using namespace esphome::gatepro;
+
+enum TestValue : uint8_t { NONE, AB, ABC, XY };
+inline constexpr GateProPattern<TestValue> TestPatterns[] = {
+   {ABC, "ABC"},
+   {AB, "AB"},
+   {XY, "XY"},
+};
+inline constexpr GateProPrefixTrie<TestValue, trie_nodes(TestPatterns)> TestTrie(TestPatterns, NONE);
+
+// resolved at compile time, too
+static_assert(TestTrie.match("XYZ") == XY);
+
+static void test_matching() {
+   CHECK_EQ(TestTrie.match("XY"), XY);
+   CHECK_EQ(TestTrie.match("XYZ"), XY);
+   // the shortest pattern that's a prefix wins
+   CHECK_EQ(TestTrie.match("ABC"), AB);
+   CHECK_EQ(TestTrie.match("ABD"), AB);
+   CHECK_EQ(TestTrie.match("A"), NONE);
+   CHECK_EQ(TestTrie.match("XZ"), NONE);
+   CHECK_EQ(TestTrie.match("xy"), NONE);
+   CHECK_EQ(TestTrie.match(""), NONE);
+}
+
+static void test_msg_types() {
+   CHECK_EQ(GateProMsgTypeTrie.match("ACK RS:00,80,C4,C6,3E,16,FF,FF,FF"), GATEPRO_MSG_ACK_RS);
+   CHECK_EQ(GateProMsgTypeTrie.match("ACK RP,1:1,0,0,1,2,2,0,0,0,3,0,0,3,0,0,0,0"), GATEPRO_MSG_ACK_RP);
+   CHECK_EQ(GateProMsgTypeTrie.match("ACK WP,1"), GATEPRO_MSG_ACK_WP);
+   CHECK_EQ(GateProMsgTypeTrie.match("$V1PKF0,17,Closed;src=0001"), GATEPRO_MSG_MOTOR_EVENT);
+   CHECK_EQ(GateProMsgTypeTrie.match("$V1PKF1"), GATPERO_MSG_FINISHED);
+   CHECK_EQ(GateProMsgTypeTrie.match("ACK READ DEVINFO:P500BU,PS21053C,V01"), GATEPRO_MSG_ACK_READ_DEVINFO);
+   CHECK_EQ(GateProMsgTypeTrie.match("ACK LEARN STATUS:SYSTEM LEARN COMPLETE,0"), GATEPRO_MSG_ACK_LEARN_STATUS);
+   CHECK_EQ(GateProMsgTypeTrie.match("ACK FULL CLOSE"), GATEPRO_MSG_ACK_FULL_CLOSE);
+   CHECK_EQ(GateProMsgTypeTrie.match("ACK FULL OPEN"), GATEPRO_MSG_ACK_FULL_OPEN);
+   CHECK_EQ(GateProMsgTypeTrie.match("ACK STOP"), GATEPRO_MSG_ACK_STOP);
+   CHECK_EQ(GateProMsgTypeTrie.match("ACK PED OPEN"), GATEPRO_MSG_ACK_PED_OPEN);
+   // truncated and unknown frames
+   CHECK_EQ(GateProMsgTypeTrie.match("ACK"), GATEPRO_MSG_UNKNOWN);
+   CHECK_EQ(GateProMsgTypeTrie.match("ACK FULL"), GATEPRO_MSG_UNKNOWN);
+   CHECK_EQ(GateProMsgTypeTrie.match("NAK"), GATEPRO_MSG_UNKNOWN);
+   CHECK_EQ(GateProMsgTypeTrie.match(" ACK RS"), GATEPRO_MSG_UNKNOWN);
+}
+
+static void test_motor_events() {
+   CHECK_EQ(MotorEventTrie.match("Opening;src=0001"), MOTOR_EVENT_OPENING);
+   CHECK_EQ(MotorEventTrie.match("Opened;src=0001"), MOTOR_EVENT_OPENED);
+   CHECK_EQ(MotorEventTrie.match("Closing;src=0001"), MOTOR_EVENT_CLOSING);
+   CHECK_EQ(MotorEventTrie.match("AutoClosing;src=0001"), MOTOR_EVENT_AUTOCLOSING);
+   CHECK_EQ(MotorEventTrie.match("Closed;src=0001"), MOTOR_EVENT_CLOSED);
+   CHECK_EQ(MotorEventTrie.match("Stopped;src=0001"), MOTOR_EVENT_STOPPED);
+   CHECK_EQ(MotorEventTrie.match("PedOpening;src=P00287D7"), MOTOR_EVENT_PED_OPENING);
+   CHECK_EQ(MotorEventTrie.match("PedOpened;src=P00287D7"), MOTOR_EVENT_PED_OPENED);
+   CHECK_EQ(MotorEventTrie.match("Open"), GATEPRO_MSG_UNKNOWN);
+   CHECK_EQ(MotorEventTrie.match("Jammed;src=0001"), GATEPRO_MSG_UNKNOWN);
+}
+
+int main() {
+   test_matching();
+   test_msg_types();
+   test_motor_events();
+   return check_result("test_prefix_trie");
+}
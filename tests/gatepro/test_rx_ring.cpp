@@ -0,0 +1,110 @@
+#include <cstring>
+#include <string_view>
+#include "check.h"
+#include "gatepro_rx_ring.h"
+
+using namespace esphome::gatepro;
+
+// copies data in the way read_msg() does, returns how much fit
+template<size_t N> static size_t feed(GateProRxRing<N> &ring, std::string_view data) {
+   size_t fed = 0;
+   while (fed < data.size()) {
+      size_t room;
+      uint8_t *dst = ring.write_ptr(room);
+      if (!room) {
+         break;
+      }
+      const size_t len = std::min(room, data.size() - fed);
+      memcpy(dst, data.data() + fed, len);
+      ring.commit(len);
+      fed += len;
+   }
+   return fed;
+}
+
+static void test_single_frame() {
+   GateProRxRing<16> ring;
+   std::string_view frame;
+   CHECK(!ring.next_frame(frame));
+   CHECK_EQ(feed(ring, "ACK RS\r\n"), 8u);
+   CHECK(ring.next_frame(frame));
+   CHECK_EQ(frame, "ACK RS");
+   CHECK_EQ(ring.size(), 0u);
+   CHECK(!ring.next_frame(frame));
+}
+
+static void test_split_frames() {
+   GateProRxRing<16> ring;
+   std::string_view frame;
+   feed(ring, "ACK");
+   CHECK(!ring.next_frame(frame));
+   // delimiter split over two reads
+   feed(ring, " RS\r");
+   CHECK(!ring.next_frame(frame));
+   feed(ring, "\nA\r\n\r\n");
+   CHECK(ring.next_frame(frame));
+   CHECK_EQ(frame, "ACK RS");
+   CHECK(ring.next_frame(frame));
+   CHECK_EQ(frame, "A");
+   CHECK(ring.next_frame(frame));
+   CHECK(frame.empty());
+   CHECK(!ring.next_frame(frame));
+}
+
+static void test_wrap() {
+   GateProRxRing<16> ring;
+   std::string_view frame;
+   feed(ring, "0123456789\r\n");
+   CHECK(ring.next_frame(frame));
+   CHECK_EQ(frame, "0123456789");
+
+   // head at 12: the frame wraps and has to be linearized
+   CHECK_EQ(feed(ring, "abcdefghij\r\n"), 12u);
+   CHECK(ring.next_frame(frame));
+   CHECK_EQ(frame, "abcdefghij");
+
+   // head at 8: the delimiter itself is split by the wrap ("\r" at 15, "\n" at 0)
+   CHECK_EQ(feed(ring, "ABCDEFG\r\nxy\r\n"), 13u);
+   CHECK(ring.next_frame(frame));
+   CHECK_EQ(frame, "ABCDEFG");
+   CHECK(ring.next_frame(frame));
+   CHECK_EQ(frame, "xy");
+   CHECK_EQ(ring.size(), 0u);
+}
+
+static void test_overflow() {
+   GateProRxRing<16> ring;
+   std::string_view frame;
+   // more than fits, without a delimiter
+   CHECK_EQ(feed(ring, "0123456789abcdefXYZ"), 16u);
+   CHECK(ring.full());
+   CHECK(!ring.exhausted());
+   CHECK(!ring.next_frame(frame));
+   CHECK(ring.exhausted());
+   size_t room;
+   ring.write_ptr(room);
+   CHECK_EQ(room, 0u);
+
+   // read_msg() drops the lot, and framing starts over
+   ring.clear();
+   CHECK(!ring.exhausted());
+   feed(ring, "ACK STOP\r\n");
+   CHECK(ring.next_frame(frame));
+   CHECK_EQ(frame, "ACK STOP");
+
+   // a full ring holding a frame isn't exhausted
+   ring.clear();
+   feed(ring, "0123456789abc\r\nX");
+   CHECK(ring.full());
+   CHECK(ring.next_frame(frame));
+   CHECK_EQ(frame, "0123456789abc");
+   CHECK_EQ(ring.size(), 1u);
+}
+
+int main() {
+   test_single_frame();
+   test_split_frames();
+   test_wrap();
+   test_overflow();
+   return check_result("test_rx_ring");
+}
@@ -0,0 +1,89 @@
+#include <initializer_list>
+#include "check.h"
+#include "gatepro_tx_queue.h"
+
+using namespace esphome::gatepro;
+
+template<size_t N> static bool holds(GateProFixedQueue<int, N> &queue, std::initializer_list<int> items) {
+   if (queue.size() != items.size()) {
+      return false;
+   }
+   size_t i = 0;
+   for (const int item : items) {
+      if (queue[i++] != item) {
+         return false;
+      }
+   }
+   return true;
+}
+
+static void test_fifo() {
+   GateProFixedQueue<int, 4> queue;
+   CHECK(queue.empty());
+   CHECK(queue.push_back(1));
+   CHECK(queue.push_back(2));
+   CHECK_EQ(queue.front(), 1);
+   queue.pop_front();
+   CHECK(holds(queue, {2}));
+   // a retry goes back to the front
+   CHECK(queue.push_front(1));
+   CHECK(holds(queue, {1, 2}));
+   queue.clear();
+   CHECK(queue.empty());
+}
+
+static void test_full() {
+   GateProFixedQueue<int, 3> queue;
+   for (int i = 1; i <= 3; i++) {
+      CHECK(queue.push_back(i));
+   }
+   CHECK(queue.full());
+   // refused both ways, nothing overwritten
+   CHECK(!queue.push_back(4));
+   CHECK(!queue.push_front(0));
+   CHECK(holds(queue, {1, 2, 3}));
+}
+
+static void test_eviction() {
+   // queue_tx() on a full poll queue: the oldest makes room for the newest, across the wrap
+   GateProFixedQueue<int, 3> queue;
+   for (int i = 1; i <= 3; i++) {
+      queue.push_back(i);
+   }
+   for (int i = 4; i <= 7; i++) {
+      CHECK(queue.full());
+      queue.pop_front();
+      CHECK(queue.push_back(i));
+   }
+   CHECK(holds(queue, {5, 6, 7}));
+}
+
+static void test_remove_if() {
+   GateProFixedQueue<int, 5> queue;
+   // start off the head, so the entries wrap
+   for (int i = 0; i < 3; i++) {
+      queue.push_back(0);
+      queue.pop_front();
+   }
+   for (int i = 1; i <= 5; i++) {
+      queue.push_back(i);
+   }
+   CHECK_EQ(queue.remove_if([](int i) { return i % 2 == 0; }), 2u);
+   CHECK(holds(queue, {1, 3, 5}));
+   CHECK_EQ(queue.remove_if([](int i) { return i > 100; }), 0u);
+   CHECK(holds(queue, {1, 3, 5}));
+   // the freed slots are usable again
+   CHECK(queue.push_back(6));
+   CHECK(queue.push_front(0));
+   CHECK(holds(queue, {0, 1, 3, 5, 6}));
+   CHECK_EQ(queue.remove_if([](int) { return true; }), 5u);
+   CHECK(queue.empty());
+}
+
+int main() {
+   test_fifo();
+   test_full();
+   test_eviction();
+   test_remove_if();
+   return check_result("test_tx_queue");
+}